@@ -44,23 +44,35 @@
 
 using namespace std;
 
+ClientSet::ClientSet()
+{
+	pthread_mutex_init(&lock, NULL);
+}
+
 void ClientSet::authenticate(string uuid)
 {
+	pthread_mutex_lock(&lock);
 	authenticatedClients.push_back(uuid);
 	save_cache();
+	pthread_mutex_unlock(&lock);
 }
 
 int ClientSet::is_authenticated(string _duuid)
 {
+	int found = 0;
+
+	pthread_mutex_lock(&lock);
 	for (vector<string>::const_iterator search = authenticatedClients.begin(); search != authenticatedClients.end(); ++search)
 	{
 		if (*search == _duuid)
 		{
-			return 1;
+			found = 1;
+			break;
 		}
 	}
+	pthread_mutex_unlock(&lock);
 	
-	return 0;
+	return found;
 }
 
 void ClientSet::clear_cache(void)
@@ -34,12 +34,15 @@
 
 #include <vector>
 #include <iostream>
+#include <pthread.h>
 
 //#include "socketset.h"
 
 class ClientSet
 {
 	public:
+		ClientSet();
+
 //		void operator += (Client & _client);
 		void authenticate(std::string _duuid);
 //		Client *get_client(int _socket);
@@ -53,6 +56,9 @@ class ClientSet
 	private:
 		std::string cache_dir;
 		std::vector<std::string> authenticatedClients;
+
+		// Listener threads authenticate clients concurrently
+		pthread_mutex_t lock;
 //		std::vector<Client> clients;
 };
 
@@ -0,0 +1,167 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+
+#include "CollectorPool.h"
+#include "Utility.h"
+
+using namespace std;
+
+void* start_collector_thread(void*);
+void* start_collector_thread(void*a)
+{
+	CollectorPool *pool = static_cast<CollectorPool*>(a);
+	pool->work();
+	return 0;
+}
+
+CollectorPool::CollectorPool()
+{
+	stats = NULL;
+	tasks = NULL;
+	next = 0;
+	remaining = 0;
+	tickTotal = 0;
+	tickSlowest = 0;
+	ticks = 0;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&available, NULL);
+	pthread_cond_init(&finished, NULL);
+}
+
+int CollectorPool::start(int _threads, Stats *_stats)
+{
+	stats = _stats;
+
+	for (int i = 0; i < _threads; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, start_collector_thread, (void*)this) != 0)
+		{
+			cout << "Could not start collector thread: " << strerror(errno) << endl;
+			break;
+		}
+		threads.push_back(thread);
+	}
+
+	return threads.size();
+}
+
+void CollectorPool::take()
+{
+	while (tasks != NULL && next < tasks->size())
+	{
+		CollectorTask *task = (*tasks)[next++];
+		pthread_mutex_unlock(&lock);
+
+		double started = get_monotonic_time();
+		task->function(stats);
+		double duration = get_monotonic_time() - started;
+
+		pthread_mutex_lock(&lock);
+		task->duration = duration;
+		task->total += duration;
+		task->slowest = max(task->slowest, duration);
+		task->runs++;
+
+		if (--remaining == 0)
+			pthread_cond_signal(&finished);
+	}
+}
+
+void CollectorPool::work()
+{
+	pthread_mutex_lock(&lock);
+	while (1)
+	{
+		while (tasks == NULL || next >= tasks->size())
+			pthread_cond_wait(&available, &lock);
+
+		take();
+	}
+}
+
+void CollectorPool::run(const vector<CollectorTask *> &_tasks)
+{
+	double started = get_monotonic_time();
+
+	pthread_mutex_lock(&lock);
+	for (vector<CollectorTask *>::const_iterator task = _tasks.begin(); task != _tasks.end(); ++task)
+	{
+		if (find(known.begin(), known.end(), *task) == known.end())
+			known.push_back(*task);
+	}
+
+	tasks = &_tasks;
+	next = 0;
+	remaining = _tasks.size();
+	if (threads.size() > 0)
+		pthread_cond_broadcast(&available);
+
+	take();
+	while (remaining > 0)
+		pthread_cond_wait(&finished, &lock);
+	tasks = NULL;
+
+	double duration = get_monotonic_time() - started;
+	tickTotal += duration;
+	tickSlowest = max(tickSlowest, duration);
+	ticks++;
+	pthread_mutex_unlock(&lock);
+}
+
+string CollectorPool::report()
+{
+	stringstream report;
+
+	report << "Collectors:";
+
+	pthread_mutex_lock(&lock);
+	if (ticks > 0)
+		report << " tick " << tickTotal / ticks * 1000 << " ms average, " << tickSlowest * 1000 << " ms slowest;";
+
+	for (vector<CollectorTask *>::iterator task = known.begin(); task != known.end(); ++task)
+	{
+		if ((*task)->runs == 0)
+			continue;
+
+		report << " " << (*task)->name << " " << (*task)->total / (*task)->runs * 1000 << " ms average, " << (*task)->slowest * 1000 << " ms slowest;";
+	}
+	pthread_mutex_unlock(&lock);
+
+	return report.str();
+}
@@ -0,0 +1,99 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _COLLECTORPOOL_H
+#define _COLLECTORPOOL_H
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+class Stats;
+
+typedef void (*CollectorFunction)(Stats *_stats);
+
+// One or more collectors that have to be updated in order, timed every tick
+class CollectorTask
+{
+	public:
+		CollectorTask(const char *_name, CollectorFunction _function) : name(_name), function(_function), duration(0), total(0), slowest(0), runs(0) {}
+
+		const char *name;
+		CollectorFunction function;
+
+		// Seconds taken by the last run, by all runs and by the slowest run
+		double duration;
+		double total;
+		double slowest;
+		unsigned long long runs;
+};
+
+// Threads that update independent collectors at the same time. The stats
+// thread takes tasks as well, a tick takes about as long as its slowest task
+// instead of the sum of all of them.
+class CollectorPool
+{
+	public:
+		CollectorPool();
+
+		// _threads helpers next to the calling thread, 0 runs every task on the calling thread
+		int start(int _threads, Stats *_stats);
+
+		// Returns once every task has finished
+		void run(const std::vector<CollectorTask *> &_tasks);
+		void work();
+
+		// Timings of each task and of whole ticks, logged on SIGUSR1
+		std::string report();
+
+	private:
+		// Runs pending tasks of the current tick until none are left, called with lock held
+		void take();
+
+		Stats *stats;
+		pthread_mutex_t lock;
+		pthread_cond_t available;
+		pthread_cond_t finished;
+		std::vector<pthread_t> threads;
+
+		const std::vector<CollectorTask *> *tasks;
+		size_t next;
+		size_t remaining;
+
+		// Every task ever run, for the report
+		std::vector<CollectorTask *> known;
+		double tickTotal;
+		double tickSlowest;
+		unsigned long long ticks;
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <algorithm>
+
+#include "CollectorSchedule.h"
+
+using namespace std;
+
+CollectorSchedule::~CollectorSchedule()
+{
+	for (vector<ScheduledCollector *>::iterator collector = collectors.begin(); collector != collectors.end(); ++collector)
+		delete *collector;
+}
+
+void CollectorSchedule::add(const char *_name, StatsBase *_stats, CollectorTask *_task, int _period)
+{
+	collectors.push_back(new ScheduledCollector(_name, _stats, _task, _period, collectors.size()));
+}
+
+ScheduledCollector * CollectorSchedule::find(const char *_name) const
+{
+	for (vector<ScheduledCollector *>::const_iterator collector = collectors.begin(); collector != collectors.end(); ++collector)
+	{
+		if (strcmp((*collector)->name, _name) == 0)
+			return *collector;
+	}
+	return NULL;
+}
+
+void CollectorSchedule::start(long long _tick)
+{
+	while (!queue.empty())
+		queue.pop();
+
+	for (vector<ScheduledCollector *>::iterator collector = collectors.begin(); collector != collectors.end(); ++collector)
+	{
+		if ((*collector)->period < 1)
+			(*collector)->period = 1;
+		(*collector)->due = _tick;
+		(*collector)->sampling = false;
+		queue.push(*collector);
+	}
+}
+
+void CollectorSchedule::take(long long _tick, vector<CollectorTask *> &_tasks)
+{
+	for (vector<ScheduledCollector *>::iterator collector = collectors.begin(); collector != collectors.end(); ++collector)
+		(*collector)->sampling = false;
+
+	while (!queue.empty() && queue.top()->due <= _tick)
+	{
+		ScheduledCollector *collector = queue.top();
+		queue.pop();
+
+		collector->sampling = true;
+		if (std::find(_tasks.begin(), _tasks.end(), collector->task) == _tasks.end())
+			_tasks.push_back(collector->task);
+
+		collector->due += collector->period;
+		if (collector->due <= _tick)
+			collector->due = _tick + 1;
+		queue.push(collector);
+	}
+}
+
+bool CollectorSchedule::sampling(const StatsBase *_stats) const
+{
+	for (vector<ScheduledCollector *>::const_iterator collector = collectors.begin(); collector != collectors.end(); ++collector)
+	{
+		if ((*collector)->stats == _stats)
+			return (*collector)->sampling;
+	}
+	return false;
+}
@@ -0,0 +1,100 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _COLLECTORSCHEDULE_H
+#define _COLLECTORSCHEDULE_H
+
+#include "config.h"
+#include <vector>
+#include <queue>
+
+#include "stats/StatBase.h"
+#include "CollectorPool.h"
+
+// A collector sampled every period ticks. Ticks between samples only move
+// its clock forward, so history keeps its place.
+class ScheduledCollector
+{
+	public:
+		ScheduledCollector(const char *_name, StatsBase *_stats, CollectorTask *_task, int _period, size_t _position) : name(_name), stats(_stats), task(_task), period(_period), position(_position), due(0), sampling(false) {}
+
+		// Config key is <name>_interval
+		const char *name;
+		StatsBase *stats;
+
+		// Shared by collectors that have to be updated together
+		CollectorTask *task;
+
+		int period;
+
+		// Collectors due in the same tick are dispatched in the order they were added
+		size_t position;
+		long long due;
+		bool sampling;
+};
+
+// Puts the collector due first on top of the queue
+class ScheduledOrder
+{
+	public:
+		bool operator () (const ScheduledCollector *a, const ScheduledCollector *b) const
+		{
+			if (a->due != b->due)
+				return b->due < a->due;
+			return b->position < a->position;
+		}
+};
+
+// Decides which collectors are sampled in each tick
+class CollectorSchedule
+{
+	public:
+		~CollectorSchedule();
+
+		void add(const char *_name, StatsBase *_stats, CollectorTask *_task, int _period);
+		ScheduledCollector * find(const char *_name) const;
+
+		// Every collector is due in tick _tick, then once per period
+		void start(long long _tick);
+
+		// Marks the collectors due in tick _tick as sampling and appends their tasks, each once
+		void take(long long _tick, std::vector<CollectorTask *> &_tasks);
+
+		// Whether _stats takes a sample in the current tick
+		bool sampling(const StatsBase *_stats) const;
+
+		std::vector<ScheduledCollector *> collectors;
+
+	private:
+		std::priority_queue<ScheduledCollector *, std::vector<ScheduledCollector *>, ScheduledOrder> queue;
+};
+
+#endif
@@ -0,0 +1,365 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <sstream>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "Compression.h"
+
+using namespace std;
+
+struct compression_counter
+{
+	unsigned long long responses;
+	unsigned long long bytesIn;
+	unsigned long long bytesOut;
+	double cpuTime;
+};
+
+// Indexed by level, level 0 counts responses sent uncompressed
+static compression_counter counters[COMPRESSION_MAX_LEVEL + 1];
+static pthread_mutex_t counterLock = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(HAVE_LIBDEFLATE) || defined(HAVE_LIBZLIB)
+static double thread_cpu_time()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec now;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0)
+		return now.tv_sec + now.tv_nsec / 1000000000.0;
+#endif
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+#endif
+
+static void count_response(int _level, size_t _in, size_t _out, double _cpuTime)
+{
+	pthread_mutex_lock(&counterLock);
+	counters[_level].responses++;
+	counters[_level].bytesIn += _in;
+	counters[_level].bytesOut += _out;
+	counters[_level].cpuTime += _cpuTime;
+	pthread_mutex_unlock(&counterLock);
+}
+
+int compression_level(size_t _length, double _cpuUsage)
+{
+	if (_length < COMPRESSION_MIN_SIZE)
+		return 0;
+
+	if (_cpuUsage >= COMPRESSION_BUSY_CPU)
+		return 1;
+
+	if (_length > COMPRESSION_LARGE_SIZE)
+		return 6;
+
+	return 9;
+}
+
+Compressor::Compressor() : streamOutput(NULL), streamPendingLevel(0), streamStarted(false), streamFailed(false), streamCpuTime(0)
+{
+#if defined(HAVE_LIBDEFLATE)
+	memset(compressors, 0, sizeof(compressors));
+#elif defined(HAVE_LIBZLIB)
+	memset(&stream, 0, sizeof(stream));
+	initialized = false;
+	streamLevel = 0;
+	chunkUsed = 0;
+#endif
+}
+
+Compressor::~Compressor()
+{
+#if defined(HAVE_LIBDEFLATE)
+	for (int i = 0; i <= COMPRESSION_MAX_LEVEL; i++)
+	{
+		if (compressors[i] != NULL)
+			libdeflate_free_compressor(compressors[i]);
+	}
+#elif defined(HAVE_LIBZLIB)
+	if (initialized)
+		deflateEnd(&stream);
+#endif
+}
+
+void Compressor::begin(int _level, deque<string> &_output)
+{
+	if (_level > COMPRESSION_MAX_LEVEL)
+		_level = COMPRESSION_MAX_LEVEL;
+
+	streamOutput = &_output;
+	streamPendingLevel = _level;
+	streamStarted = false;
+	streamFailed = false;
+	streamCpuTime = 0;
+}
+
+#if defined(HAVE_LIBDEFLATE)
+
+int Compressor::compress(const string &_data, int _level, deque<string> &_output)
+{
+	if (_level > COMPRESSION_MAX_LEVEL)
+		_level = COMPRESSION_MAX_LEVEL;
+
+	if (_level > 0)
+	{
+		double start = thread_cpu_time();
+
+		if (compressors[_level] == NULL)
+			compressors[_level] = libdeflate_alloc_compressor(_level);
+
+		if (compressors[_level] != NULL)
+		{
+			// Sized for the worst case up front so the data is compressed in one call
+			string compressed;
+			compressed.resize(libdeflate_zlib_compress_bound(compressors[_level], _data.size()));
+
+			size_t length = libdeflate_zlib_compress(compressors[_level], _data.data(), _data.size(), &compressed[0], compressed.size());
+
+			// Output no smaller than the input is not worth the client inflating it
+			if (length > 0 && length < _data.size())
+			{
+				compressed.resize(length);
+				_output.push_back(string());
+				_output.back().swap(compressed);
+				count_response(_level, _data.size(), length, thread_cpu_time() - start);
+				return 1;
+			}
+		}
+	}
+
+	count_response(0, _data.size(), _data.size(), 0);
+	return 0;
+}
+
+// libdeflate only compresses whole buffers, responses are compressed once they are built
+bool Compressor::can_stream()
+{
+	return false;
+}
+
+void Compressor::consume(const char *, size_t)
+{
+}
+
+int Compressor::finish(const string &)
+{
+	return 0;
+}
+
+#elif defined(HAVE_LIBZLIB)
+
+int Compressor::start_stream(int _level)
+{
+	if (_level > Z_BEST_COMPRESSION)
+		_level = Z_BEST_COMPRESSION;
+
+	// The stream is reset rather than set up again, which keeps zlib's window and hash tables
+	if (!initialized)
+	{
+		if (deflateInit(&stream, _level) != Z_OK)
+			return 0;
+		initialized = true;
+	}
+	else
+	{
+		deflateReset(&stream);
+		if (streamLevel != _level && deflateParams(&stream, _level, Z_DEFAULT_STRATEGY) != Z_OK)
+			return 0;
+	}
+	streamLevel = _level;
+	chunkUsed = 0;
+	return 1;
+}
+
+// Deflates _data into fixed size chunks appended to _output
+int Compressor::deflate_chunks(const char *_data, size_t _length, int _flush, deque<string> &_output)
+{
+	stream.next_in = (Bytef *)_data;
+	stream.avail_in = _length;
+
+	while (1)
+	{
+		if (_output.empty() || chunkUsed == _output.back().size())
+		{
+			_output.push_back(string());
+			_output.back().resize(COMPRESSION_CHUNK_SIZE);
+			chunkUsed = 0;
+		}
+
+		string &chunk = _output.back();
+		stream.next_out = (Bytef *)&chunk[chunkUsed];
+		stream.avail_out = chunk.size() - chunkUsed;
+
+		int ret = deflate(&stream, _flush);
+		chunkUsed = chunk.size() - stream.avail_out;
+
+		if (ret == Z_STREAM_ERROR)
+			return 0;
+
+		if (_flush == Z_FINISH)
+		{
+			if (ret == Z_STREAM_END)
+				break;
+
+			// No progress with output space left, the stream cannot be finished
+			if (ret == Z_BUF_ERROR && stream.avail_out > 0)
+				return 0;
+		}
+		// Without a finish zlib may hold output back until the next call, Z_BUF_ERROR only means it had no input left
+		else if (stream.avail_in == 0)
+			break;
+	}
+
+	if (_flush == Z_FINISH)
+		_output.back().resize(chunkUsed);
+
+	return 1;
+}
+
+int Compressor::compress(const string &_data, int _level, deque<string> &_output)
+{
+	if (_level > 0)
+	{
+		double start = thread_cpu_time();
+
+		size_t chunks = _output.size();
+		if (start_stream(_level) && deflate_chunks(_data.data(), _data.size(), Z_FINISH, _output))
+		{
+			// Output no smaller than the input is not worth the client inflating it
+			if (stream.total_out < _data.size())
+			{
+				count_response(_level, _data.size(), stream.total_out, thread_cpu_time() - start);
+				return 1;
+			}
+		}
+		_output.resize(chunks);
+	}
+
+	count_response(0, _data.size(), _data.size(), 0);
+	return 0;
+}
+
+bool Compressor::can_stream()
+{
+	return true;
+}
+
+void Compressor::consume(const char *_data, size_t _length)
+{
+	if (streamFailed || streamOutput == NULL)
+		return;
+
+	double start = thread_cpu_time();
+
+	if (!streamStarted)
+	{
+		streamStarted = true;
+		if (!start_stream(streamPendingLevel))
+		{
+			streamFailed = true;
+			return;
+		}
+	}
+
+	if (!deflate_chunks(_data, _length, Z_NO_FLUSH, *streamOutput))
+		streamFailed = true;
+
+	streamCpuTime += thread_cpu_time() - start;
+}
+
+// Compresses the rest of a response started with begin(). Returns 0 when the stream could not be completed.
+int Compressor::finish(const string &_rest)
+{
+	double start = thread_cpu_time();
+
+	if (!streamFailed && !deflate_chunks(_rest.data(), _rest.size(), Z_FINISH, *streamOutput))
+		streamFailed = true;
+
+	streamCpuTime += thread_cpu_time() - start;
+	streamStarted = false;
+	streamOutput = NULL;
+
+	if (streamFailed)
+		return 0;
+
+	count_response(streamLevel, stream.total_in, stream.total_out, streamCpuTime);
+	return 1;
+}
+
+#else
+
+int Compressor::compress(const string &_data, int, deque<string> &)
+{
+	count_response(0, _data.size(), _data.size(), 0);
+	return 0;
+}
+
+bool Compressor::can_stream()
+{
+	return false;
+}
+
+void Compressor::consume(const char *, size_t)
+{
+}
+
+int Compressor::finish(const string &)
+{
+	return 0;
+}
+
+#endif
+
+string CompressionReport()
+{
+	stringstream report;
+
+	report << "Compression:";
+
+	pthread_mutex_lock(&counterLock);
+	for (int i = 0; i <= COMPRESSION_MAX_LEVEL; i++)
+	{
+		if (counters[i].responses == 0)
+			continue;
+
+		if (i == 0)
+			report << " none " << counters[i].responses << " responses, " << counters[i].bytesIn << " bytes;";
+		else
+			report << " level " << i << " " << counters[i].responses << " responses, " << counters[i].bytesIn << " -> " << counters[i].bytesOut << " bytes, " << counters[i].cpuTime * 1000 << " ms;";
+	}
+	pthread_mutex_unlock(&counterLock);
+
+	return report.str();
+}
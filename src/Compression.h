@@ -0,0 +1,111 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _COMPRESSION_H
+#define _COMPRESSION_H
+
+#include "config.h"
+#include <string>
+#include <deque>
+
+#ifdef HAVE_LIBZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#include "OutputBuffer.h"
+
+// Payloads below this many bytes are sent uncompressed, deflate would barely shrink them
+#define COMPRESSION_MIN_SIZE 512
+
+// Payloads above this many bytes use a cheaper level, full history responses spend most of their time here
+#define COMPRESSION_LARGE_SIZE (64 * 1024)
+
+// CPU usage in percent above which responses are compressed with the fastest level
+#define COMPRESSION_BUSY_CPU 80
+
+// Highest level either backend accepts, libdeflate goes up to 12
+#define COMPRESSION_MAX_LEVEL 12
+
+// Size of the chunks compressed output is written in, one socket write each
+#define COMPRESSION_CHUNK_SIZE 16384
+
+// Picks the deflate level for a response, 0 to send it uncompressed
+int compression_level(size_t _length, double _cpuUsage);
+
+// Compresses responses into the zlib format clients inflate. Holds the
+// compressor state, so each worker thread keeps one and reuses it.
+//
+// With zlib a response can also be compressed while it is being built: after
+// begin(), the compressor is set as the sink of the response's OutputBuffer
+// and deflates each part handed to it, finish() takes what is left.
+class Compressor : public OutputSink
+{
+	public:
+		Compressor();
+		~Compressor();
+
+		// Returns 1 and fills _output when _data was compressed, 0 when it should be sent as is
+		int compress(const std::string &_data, int _level, std::deque<std::string> &_output);
+
+		bool can_stream();
+		void begin(int _level, std::deque<std::string> &_output);
+		void consume(const char *_data, size_t _length);
+		bool streaming() { return streamStarted; }
+		int finish(const std::string &_rest);
+
+	private:
+#if defined(HAVE_LIBDEFLATE)
+		struct libdeflate_compressor *compressors[COMPRESSION_MAX_LEVEL + 1];
+#elif defined(HAVE_LIBZLIB)
+		int start_stream(int _level);
+		int deflate_chunks(const char *_data, size_t _length, int _flush, std::deque<std::string> &_output);
+
+		z_stream stream;
+		bool initialized;
+		int streamLevel;
+		size_t chunkUsed;
+#endif
+
+		// State of the response being compressed as it is built
+		std::deque<std::string> *streamOutput;
+		int streamPendingLevel;
+		bool streamStarted;
+		bool streamFailed;
+		double streamCpuTime;
+};
+
+std::string CompressionReport();
+
+#endif
@@ -254,5 +254,10 @@ void SignalResponder::on_sigterm()
 
 void SignalResponder::on_sighup()
 {
-	cout << "Placeholder for reloading config." << endl;
+	reloadPending = 1;
+}
+
+void SignalResponder::on_sigusr1()
+{
+	reportPending = 1;
 }
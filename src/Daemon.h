@@ -57,12 +57,19 @@ class Daemon
 class SignalResponder
 {
 	public:
-		SignalResponder(SocketSet *_sockets, Socket *_listener, Daemon *_unixdaemon, Stats *_stats) : listener(_listener), sockets(_sockets), unixdaemon(_unixdaemon), stats(_stats) {}
+		SignalResponder(SocketSet *_sockets, Socket *_listener, Daemon *_unixdaemon, Stats *_stats) : reloadPending(0), reportPending(0), listener(_listener), sockets(_sockets), unixdaemon(_unixdaemon), stats(_stats) {}
 		
 		void destroy();
 		void on_sigint();
 		void on_sigterm();
 		void on_sighup();
+		void on_sigusr1();
+
+		// Set from the signal handler, the main loop rebuilds the TLS context
+		volatile sig_atomic_t reloadPending;
+
+		// Set from the signal handler, the main loop prints server counters
+		volatile sig_atomic_t reportPending;
 
 	private:
 		Socket * listener;
@@ -171,7 +171,8 @@ int DatabaseItem::executeUpdate()
 void Database::init()
 {
 	string path = string(CONFIG_PATH) + "istatserver.db";
-	int rc = sqlite3_open(path.c_str(), &_db);
+	// Collectors running side by side share the connection
+	int rc = sqlite3_open_v2(path.c_str(), &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL);
 	if(rc != SQLITE_OK)
 	{
 		cout << "Unable to open database" << endl;
@@ -0,0 +1,208 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <iostream>
+
+#include "EventLoop.h"
+#include "Utility.h"
+
+using namespace std;
+
+void* start_event_loop(void*);
+void* start_event_loop(void*a)
+{
+	EventLoop *loop = static_cast<EventLoop*>(a);
+	loop->run();
+	return 0;
+}
+
+EventLoop::EventLoop(ClientSet *_clients, Config *_config, Stats *_stats) : listener("", 0)
+{
+	clients = _clients;
+	config = _config;
+	stats = _stats;
+	pendingContext = NULL;
+	pthread_mutex_init(&contextLock, NULL);
+}
+
+// Copies the configured listener, binds it and starts the workers for its connections
+int EventLoop::start(const Socket &_listener, int _backlog, bool _shared, int _threads)
+{
+	listener = _listener;
+	listener.sslContext = NULL;
+
+	if (!listener.listen(_backlog, _shared)) return 0;
+
+	sockets += listener;
+
+	if (!workers.start(_threads, stats)) return 0;
+
+	listener.workers = &workers;
+	sockets.watch(workers.get_id());
+
+	return 1;
+}
+
+// Runs the loop on its own thread. Signals stay with the main thread.
+int EventLoop::spawn()
+{
+	sigset_t blocked, previous;
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+
+	int result = pthread_create(&thread, NULL, start_event_loop, (void*)this);
+
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	if (result != 0)
+	{
+		cout << "Could not start listener thread: " << strerror(result) << endl;
+		return 0;
+	}
+
+	return 1;
+}
+
+void EventLoop::run()
+{
+	while (1)
+		poll();
+}
+
+void EventLoop::set_context(SSL_CTX *_context)
+{
+	if (_context == NULL)
+		return;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	CRYPTO_add(&_context->references, 1, CRYPTO_LOCK_SSL_CTX);
+#else
+	SSL_CTX_up_ref(_context);
+#endif
+
+	pthread_mutex_lock(&contextLock);
+	if (pendingContext != NULL)
+		SSL_CTX_free(pendingContext);
+	pendingContext = _context;
+	pthread_mutex_unlock(&contextLock);
+}
+
+// Waits up to a second for socket activity and handles it
+void EventLoop::poll()
+{
+	pthread_mutex_lock(&contextLock);
+	if (pendingContext != NULL)
+	{
+		// Existing sessions keep a reference to the old context, so it is only released here
+		if (listener.sslContext != NULL)
+			SSL_CTX_free(listener.sslContext);
+		listener.sslContext = pendingContext;
+		pendingContext = NULL;
+	}
+	pthread_mutex_unlock(&contextLock);
+
+	int ready = sockets.get_status(1);
+	bool accepting = false;
+
+	for (int i = 0; i < ready; i++)
+	{
+		int fd = sockets.ready[i];
+
+		// Accept after the batch, so a reused descriptor never picks up a stale event
+		if (fd == listener.get_id())
+		{
+			accepting = true;
+			continue;
+		}
+
+		if (fd == workers.get_id())
+		{
+			completed();
+			continue;
+		}
+
+		Socket *active_socket = sockets.get_socket(fd);
+		if (active_socket == NULL)
+			continue;
+
+		if (!active_socket->flush() || !active_socket->receive(clients, config, stats))
+		{
+			sockets -= *active_socket;
+			continue;
+		}
+
+		// Responses left waiting to be written start the write stall deadline
+		sockets.schedule(*active_socket);
+	}
+
+	while (accepting)
+	{
+		Socket *new_socket = listener.accept();
+		if (new_socket == NULL)
+			break;
+
+		new_socket->debugLogging = listener.debugLogging;
+
+		// The handshake carries on from the socket set as the client responds
+		if (new_socket->startSSL() < 0)
+		{
+			new_socket->close();
+			delete new_socket;
+			continue;
+		}
+		sockets += new_socket;
+	}
+
+	sockets.expire(get_monotonic_time());
+}
+
+void EventLoop::completed()
+{
+	vector<ResponseJob *> jobs;
+	workers.completed(jobs);
+
+	for (vector<ResponseJob *>::iterator job = jobs.begin(); job != jobs.end(); ++job)
+	{
+		Socket *owner = sockets.get_socket((*job)->socket);
+		if (owner != NULL && owner->serial == (*job)->serial)
+		{
+			if (!owner->complete(*job, clients, config, stats))
+				sockets -= *owner;
+			else
+				sockets.schedule(*owner);
+		}
+		delete *job;
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _EVENTLOOP_H
+#define _EVENTLOOP_H
+
+#include "config.h"
+#include <pthread.h>
+
+#include "Socket.h"
+#include "Socketset.h"
+#include "Clientset.h"
+#include "Conf.h"
+#include "Stats.h"
+#include "WorkerPool.h"
+
+// One listener with the connections it accepted, the socket set watching
+// them and the workers building their responses. Several loops can share
+// a port through SO_REUSEPORT, each on its own thread.
+class EventLoop
+{
+	public:
+		EventLoop(ClientSet *_clients, Config *_config, Stats *_stats);
+
+		int start(const Socket &_listener, int _backlog, bool _shared, int _threads);
+		int spawn();
+		void run();
+		void poll();
+
+		// Hands a new TLS context to the loop, it is picked up before the next accept
+		void set_context(SSL_CTX *_context);
+
+		Socket listener;
+		SocketSet sockets;
+		WorkerPool workers;
+
+	private:
+		void completed();
+
+		ClientSet *clients;
+		Config *config;
+		Stats *stats;
+
+		pthread_mutex_t contextLock;
+		SSL_CTX *pendingContext;
+		pthread_t thread;
+};
+
+#endif
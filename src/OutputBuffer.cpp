@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <math.h>
+
+#include "OutputBuffer.h"
+
+using namespace std;
+
+void OutputBuffer::drain()
+{
+	sink->consume(data.data(), data.size());
+	data.clear();
+}
+
+void OutputBuffer::append_unsigned(unsigned long long _value)
+{
+	char buffer[24];
+	char *end = buffer + sizeof(buffer);
+	char *start = end;
+
+	do
+	{
+		*--start = '0' + (_value % 10);
+		_value /= 10;
+	} while (_value > 0);
+
+	data.append(start, end - start);
+}
+
+void OutputBuffer::append_signed(long long _value)
+{
+	if (_value < 0)
+	{
+		data.push_back('-');
+		append_unsigned(0ULL - (unsigned long long)_value);
+		return;
+	}
+
+	append_unsigned(_value);
+}
+
+// Matches ostream's default of six significant digits
+void OutputBuffer::append_double(double _value)
+{
+	// Whole numbers below a million print the same as integers, most counters and percentages land here
+	if (_value > -1000000 && _value < 1000000 && _value == (double)(long long)_value)
+	{
+		if (_value == 0 && signbit(_value))
+			data.push_back('-');
+		append_signed((long long)_value);
+		return;
+	}
+
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%g", _value);
+	if (length > 0)
+		data.append(buffer, length);
+}
+
+// Writes _text with XML special and non ASCII characters escaped. Runs of
+// plain characters are copied in one go, nothing is allocated for them.
+void OutputBuffer::append_escaped(const char *_text, size_t _length)
+{
+	size_t plain = 0;
+
+	for (size_t i = 0; i < _length; i++)
+	{
+		unsigned char c = (unsigned char)_text[i];
+		const char *entity = NULL;
+
+		switch (c)
+		{
+			case '&': entity = "&amp;"; break;
+			case '<': entity = "&lt;"; break;
+			case '>': entity = "&gt;"; break;
+			case '"': entity = "&quot;"; break;
+			case '\'': entity = "&apos;"; break;
+			default:
+				if (c >= 32 && c <= 127)
+					continue;
+		}
+
+		data.append(_text + plain, i - plain);
+		plain = i + 1;
+
+		if (entity != NULL)
+		{
+			data.append(entity);
+		}
+		else
+		{
+			data.append("&#", 2);
+			append_unsigned(c);
+			data.push_back(';');
+		}
+	}
+
+	data.append(_text + plain, _length - plain);
+}
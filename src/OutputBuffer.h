@@ -0,0 +1,104 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _OUTPUTBUFFER_H
+#define _OUTPUTBUFFER_H
+
+#include "config.h"
+#include <string.h>
+#include <string>
+
+// Text to be written with XML escaping, see OutputBuffer::append_escaped()
+class EscapedXml
+{
+	public:
+		explicit EscapedXml(const std::string &_text) : text(_text.data()), length(_text.size()) {}
+		explicit EscapedXml(const char *_text) : text(_text), length(strlen(_text)) {}
+
+		const char *text;
+		size_t length;
+};
+
+// Receives the contents of an OutputBuffer whenever it grows past a threshold
+class OutputSink
+{
+	public:
+		virtual ~OutputSink() {}
+		virtual void consume(const char *_data, size_t _length) = 0;
+};
+
+// Append-only buffer responses are built in. Clearing keeps the capacity, so
+// a buffer that is reused for every response stops allocating once it has
+// grown to the size of the largest one. Numbers are written the way an
+// ostream with default flags writes them, clients see the same text.
+class OutputBuffer
+{
+	public:
+		OutputBuffer() : sink(NULL), threshold(0) {}
+
+		// Hands the contents to _sink and empties the buffer whenever it holds _threshold bytes or more
+		void set_sink(OutputSink *_sink, size_t _threshold) { sink = _sink; threshold = _threshold; }
+
+		void clear() { data.clear(); }
+		void reserve(size_t _size) { data.reserve(_size); }
+		size_t size() const { return data.size(); }
+		const std::string & str() const { return data; }
+		void swap(std::string &_other) { data.swap(_other); }
+
+		void append(const char *_data, size_t _length) { data.append(_data, _length); check(); }
+		void append_escaped(const char *_text, size_t _length);
+
+		OutputBuffer & operator << (const char *_text) { data.append(_text, strlen(_text)); check(); return *this; }
+		OutputBuffer & operator << (const std::string &_text) { data.append(_text); check(); return *this; }
+		OutputBuffer & operator << (const EscapedXml &_text) { append_escaped(_text.text, _text.length); check(); return *this; }
+		OutputBuffer & operator << (char _character) { data.push_back(_character); check(); return *this; }
+		OutputBuffer & operator << (int _value) { append_signed(_value); check(); return *this; }
+		OutputBuffer & operator << (long _value) { append_signed(_value); check(); return *this; }
+		OutputBuffer & operator << (long long _value) { append_signed(_value); check(); return *this; }
+		OutputBuffer & operator << (unsigned int _value) { append_unsigned(_value); check(); return *this; }
+		OutputBuffer & operator << (unsigned long _value) { append_unsigned(_value); check(); return *this; }
+		OutputBuffer & operator << (unsigned long long _value) { append_unsigned(_value); check(); return *this; }
+		OutputBuffer & operator << (float _value) { append_double(_value); check(); return *this; }
+		OutputBuffer & operator << (double _value) { append_double(_value); check(); return *this; }
+
+	private:
+		void check() { if (sink != NULL && data.size() >= threshold) drain(); }
+		void drain();
+		void append_signed(long long _value);
+		void append_unsigned(unsigned long long _value);
+		void append_double(double _value);
+
+		std::string data;
+		OutputSink *sink;
+		size_t threshold;
+};
+
+#endif
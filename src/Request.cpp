@@ -0,0 +1,561 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Request.h"
+#include "Utility.h"
+
+using namespace std;
+
+// Cursor over the text of one request
+class RequestReader
+{
+	public:
+		RequestReader(const char *_data, size_t _length) : emptyElement(false), position(_data), end(_data + _length) {}
+
+		bool at_end() { return position >= end; }
+
+		void skip_space()
+		{
+			while (position < end && (*position == ' ' || *position == '\t' || *position == '\r' || *position == '\n'))
+				position++;
+		}
+
+		bool consume(char _character)
+		{
+			if (position >= end || *position != _character)
+				return false;
+			position++;
+			return true;
+		}
+
+		bool starts_with(const char *_text)
+		{
+			size_t length = strlen(_text);
+			return (size_t)(end - position) >= length && memcmp(position, _text, length) == 0;
+		}
+
+		bool skip_past(const char *_text)
+		{
+			size_t length = strlen(_text);
+			while ((size_t)(end - position) >= length)
+			{
+				if (memcmp(position, _text, length) == 0)
+				{
+					position += length;
+					return true;
+				}
+				position++;
+			}
+			return false;
+		}
+
+		bool read_name(const char *&_name, size_t &_length)
+		{
+			_name = position;
+			while (position < end && (isalnum((unsigned char)*position) || *position == '_' || *position == '-' || *position == '.' || *position == ':'))
+				position++;
+			_length = position - _name;
+			return _length > 0;
+		}
+
+		// Reads the next attribute of the open tag. Returns 1 for an attribute, 0 once the
+		// tag is closed and -1 for anything the fast parser does not handle.
+		int read_attribute(const char *&_name, size_t &_nameLength, const char *&_value, size_t &_valueLength)
+		{
+			skip_space();
+			if (consume('>'))
+			{
+				emptyElement = false;
+				return 0;
+			}
+			if (starts_with("/>"))
+			{
+				position += 2;
+				emptyElement = true;
+				return 0;
+			}
+
+			if (!read_name(_name, _nameLength))
+				return -1;
+			skip_space();
+			if (!consume('='))
+				return -1;
+			skip_space();
+			if (position >= end || (*position != '"' && *position != '\''))
+				return -1;
+
+			char quote = *position++;
+			_value = position;
+			while (position < end && *position != quote)
+			{
+				// Entities need decoding, leave those to libxml
+				if (*position == '&' || *position == '<')
+					return -1;
+				position++;
+			}
+			if (position >= end)
+				return -1;
+
+			_valueLength = position - _value;
+			position++;
+			return 1;
+		}
+
+		// Reads the closing tag of the element named _name
+		bool read_end(const char *_name, size_t _nameLength)
+		{
+			const char *name;
+			size_t nameLength;
+
+			position += 2;
+			if (!read_name(name, nameLength) || nameLength != _nameLength || memcmp(name, _name, nameLength) != 0)
+				return false;
+			skip_space();
+			return consume('>');
+		}
+
+		bool emptyElement;
+
+	private:
+		const char *position;
+		const char *end;
+};
+
+// Splits a | separated list the way explode() does, empty parts are skipped
+// and a part starting with a quote runs to the closing quote
+class ListReader
+{
+	public:
+		ListReader(const char *_data, size_t _length) : position(_data), end(_data + _length), done(false) {}
+
+		bool next(const char *&_part, size_t &_length)
+		{
+			while (!done)
+			{
+				const char *bar = (const char *)memchr(position, '|', end - position);
+				size_t split = bar != NULL ? bar - position : end - position;
+
+				if (position < end && *position == '"')
+				{
+					const char *quote = (const char *)memchr(position + 1, '"', end - position - 1);
+					if (quote != NULL)
+						split = quote - position + 1;
+				}
+
+				_part = position;
+				_length = split < (size_t)(end - position) ? split : end - position;
+
+				position = split + 1 < (size_t)(end - position) ? position + split + 1 : end;
+				if (bar == NULL)
+					done = true;
+
+				if (_length > 0)
+					return true;
+			}
+			return false;
+		}
+
+	private:
+		const char *position;
+		const char *end;
+		bool done;
+};
+
+static bool name_is(const char *_name, size_t _length, const char *_expected)
+{
+	return strlen(_expected) == _length && memcmp(_name, _expected, _length) == 0;
+}
+
+// Numbers in requests are short, longer text is not a number to begin with
+static const char * terminated(const char *_text, size_t _length, char *_buffer, size_t _size)
+{
+	if (_length >= _size)
+		_length = 0;
+	memcpy(_buffer, _text, _length);
+	_buffer[_length] = 0;
+	return _buffer;
+}
+
+static void parse_samples(const char *_text, size_t _length, vector<double> &_samples)
+{
+	char buffer[64];
+	const char *part;
+	size_t partLength;
+
+	_samples.clear();
+
+	ListReader list(_text, _length);
+	while (_samples.size() < REQUEST_MAX_TIERS && list.next(part, partLength))
+		_samples.push_back(strtod(terminated(part, partLength, buffer, sizeof(buffer)), NULL));
+}
+
+// Fills _keys in place, strings already in the vector are reused
+static void parse_keys(const char *_text, size_t _length, vector<string> &_keys)
+{
+	const char *part;
+	size_t partLength;
+	size_t count = 0;
+
+	ListReader list(_text, _length);
+	while (list.next(part, partLength))
+	{
+		if (count == _keys.size())
+			_keys.push_back(string());
+		_keys[count++].assign(part, partLength);
+	}
+	_keys.resize(count);
+}
+
+template <class T>
+static T & next_slot(vector<T> &_slots, size_t &_count)
+{
+	if (_count == _slots.size())
+		_slots.push_back(T());
+	return _slots[_count++];
+}
+
+// Copies only the parsed fields, each object makes its own libxml parser
+Request::Request(const Request &_other) : type(_other.type), protocol(_other.protocol), uuid(_other.uuid), name(_other.name), version(_other.version), code(_other.code), items(_other.items), context(NULL)
+{
+}
+
+Request & Request::operator = (const Request &_other)
+{
+	Request copy(_other);
+	swap(copy);
+	return *this;
+}
+
+bool RequestEntry::has_key(const string &_key) const
+{
+	if (keySlots.empty())
+		return false;
+
+	size_t mask = keySlots.size() - 1;
+	for (size_t slot = hash_bytes(_key.data(), _key.size()) & mask; keySlots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		if (keys[keySlots[slot] - 1] == _key)
+			return true;
+	}
+	return false;
+}
+
+void RequestEntry::index_keys()
+{
+	// At most half full, so probes stay short
+	size_t size = 1;
+	while (size < keys.size() * 2)
+		size *= 2;
+
+	if (keys.empty())
+		size = 0;
+
+	keySlots.assign(size, 0);
+	if (size == 0)
+		return;
+
+	size_t mask = size - 1;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		size_t slot = hash_bytes(keys[i].data(), keys[i].size()) & mask;
+		while (keySlots[slot] != 0)
+			slot = (slot + 1) & mask;
+		keySlots[slot] = i + 1;
+	}
+}
+
+Request::~Request()
+{
+	if (context != NULL)
+		xmlFreeParserCtxt(context);
+}
+
+void Request::reset()
+{
+	type = 0;
+	protocol.clear();
+	uuid.clear();
+	name.clear();
+	version.clear();
+	code.clear();
+}
+
+void Request::swap(Request &_other)
+{
+	std::swap(type, _other.type);
+	protocol.swap(_other.protocol);
+	uuid.swap(_other.uuid);
+	name.swap(_other.name);
+	version.swap(_other.version);
+	code.swap(_other.code);
+	items.swap(_other.items);
+}
+
+int Request::parse(const char *_data, size_t _length)
+{
+	if (parse_fast(_data, _length))
+		return 1;
+
+	return parse_document(_data, _length);
+}
+
+int Request::parse_fast(const char *_data, size_t _length)
+{
+	RequestReader reader(_data, _length);
+	const char *element, *attribute, *value;
+	size_t elementLength, attributeLength, valueLength;
+	char buffer[32];
+	int result;
+
+	reset();
+
+	// The XML declaration carries nothing a request needs
+	reader.skip_space();
+	if (reader.starts_with("<?xml") && !reader.skip_past("?>"))
+		return 0;
+	reader.skip_space();
+
+	const char *root;
+	size_t rootLength;
+	if (!reader.consume('<') || !reader.read_name(root, rootLength) || !name_is(root, rootLength, "isr"))
+		return 0;
+
+	while ((result = reader.read_attribute(attribute, attributeLength, value, valueLength)) == 1)
+	{
+		if (name_is(attribute, attributeLength, "type"))
+			type = atoi(terminated(value, valueLength, buffer, sizeof(buffer)));
+		else if (name_is(attribute, attributeLength, "protocol"))
+			protocol.assign(value, valueLength);
+		else if (name_is(attribute, attributeLength, "uuid"))
+			uuid.assign(value, valueLength);
+		else if (name_is(attribute, attributeLength, "name"))
+			name.assign(value, valueLength);
+		else if (name_is(attribute, attributeLength, "version"))
+			version.assign(value, valueLength);
+		else if (name_is(attribute, attributeLength, "code"))
+			code.assign(value, valueLength);
+	}
+	if (result < 0)
+		return 0;
+
+	size_t itemCount = 0;
+	bool open = !reader.emptyElement;
+	while (open)
+	{
+		reader.skip_space();
+		if (reader.starts_with("</"))
+		{
+			if (!reader.read_end(root, rootLength))
+				return 0;
+			break;
+		}
+
+		// Text, comments and processing instructions fail here
+		if (!reader.consume('<') || !reader.read_name(element, elementLength))
+			return 0;
+
+		RequestItem &item = next_slot(items, itemCount);
+		bool typed = false;
+		item.type.clear();
+		item.samples.clear();
+
+		while ((result = reader.read_attribute(attribute, attributeLength, value, valueLength)) == 1)
+		{
+			if (name_is(attribute, attributeLength, "type"))
+			{
+				item.type.assign(value, valueLength);
+				typed = true;
+			}
+			else if (name_is(attribute, attributeLength, "samples"))
+				parse_samples(value, valueLength, item.samples);
+		}
+		if (result < 0)
+			return 0;
+
+		size_t entryCount = 0;
+		bool itemOpen = !reader.emptyElement;
+		while (itemOpen)
+		{
+			reader.skip_space();
+			if (reader.starts_with("</"))
+			{
+				if (!reader.read_end(element, elementLength))
+					return 0;
+				break;
+			}
+
+			const char *entryElement;
+			size_t entryElementLength;
+			if (!reader.consume('<') || !reader.read_name(entryElement, entryElementLength))
+				return 0;
+
+			RequestEntry &entry = next_slot(item.entries, entryCount);
+			entry.samples.clear();
+			entry.hasKeys = false;
+
+			while ((result = reader.read_attribute(attribute, attributeLength, value, valueLength)) == 1)
+			{
+				if (name_is(attribute, attributeLength, "samples"))
+					parse_samples(value, valueLength, entry.samples);
+				else if (name_is(attribute, attributeLength, "keys"))
+				{
+					parse_keys(value, valueLength, entry.keys);
+					entry.hasKeys = true;
+				}
+			}
+			if (result < 0)
+				return 0;
+			if (!entry.hasKeys)
+				entry.keys.clear();
+			entry.index_keys();
+
+			// Requests are never nested deeper, anything else goes to libxml
+			if (!reader.emptyElement)
+			{
+				reader.skip_space();
+				if (!reader.starts_with("</") || !reader.read_end(entryElement, entryElementLength))
+					return 0;
+			}
+		}
+		item.entries.resize(entryCount);
+
+		// Items without a type are skipped when the response is built
+		if (!typed)
+			itemCount--;
+	}
+
+	reader.skip_space();
+	if (!reader.at_end())
+		return 0;
+
+	items.resize(itemCount);
+	return 1;
+}
+
+static void read_property(xmlNodePtr _node, const char *_name, string &_value)
+{
+	char *value = (char *)xmlGetProp(_node, (const xmlChar *)_name);
+	if (value != NULL)
+	{
+		_value.assign(value);
+		free(value);
+	}
+	else
+	{
+		_value.clear();
+	}
+}
+
+static void read_samples(xmlNodePtr _node, vector<double> &_samples)
+{
+	char *value = (char *)xmlGetProp(_node, (const xmlChar *)"samples");
+	if (value != NULL)
+	{
+		parse_samples(value, strlen(value), _samples);
+		free(value);
+	}
+	else
+	{
+		_samples.clear();
+	}
+}
+
+// Fallback for requests the fast parser does not understand
+int Request::parse_document(const char *_data, size_t _length)
+{
+	reset();
+	items.clear();
+
+	if (context == NULL)
+		context = xmlNewParserCtxt();
+	if (context == NULL)
+		return 0;
+
+	xmlDocPtr doc = xmlCtxtReadMemory(context, _data, _length, NULL, NULL, 0);
+	xmlNodePtr root = xmlDocGetRootElement(doc);
+	if (root == NULL || !xmlStrEqual(root->name, BAD_CAST "isr"))
+	{
+		xmlFreeDoc(doc);
+		return 0;
+	}
+
+	string value;
+	read_property(root, "type", value);
+	type = atoi(value.c_str());
+	read_property(root, "protocol", protocol);
+	read_property(root, "uuid", uuid);
+	read_property(root, "name", name);
+	read_property(root, "version", version);
+	read_property(root, "code", code);
+
+	for (xmlNodePtr child = root->children; child != NULL; child = child->next)
+	{
+		char *itemType = (char *)xmlGetProp(child, (const xmlChar *)"type");
+		if (child->type != XML_ELEMENT_NODE || itemType == NULL)
+		{
+			free(itemType);
+			continue;
+		}
+
+		items.push_back(RequestItem());
+		RequestItem &item = items.back();
+		item.type = itemType;
+		free(itemType);
+		read_samples(child, item.samples);
+
+		for (xmlNodePtr node = child->children; node != NULL; node = node->next)
+		{
+			if (node->type != XML_ELEMENT_NODE)
+				continue;
+
+			item.entries.push_back(RequestEntry());
+			RequestEntry &entry = item.entries.back();
+			read_samples(node, entry.samples);
+
+			char *keys = (char *)xmlGetProp(node, (const xmlChar *)"keys");
+			if (keys != NULL)
+			{
+				parse_keys(keys, strlen(keys), entry.keys);
+				entry.hasKeys = true;
+				free(keys);
+			}
+			entry.index_keys();
+		}
+	}
+
+	xmlFreeDoc(doc);
+	return 1;
+}
@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _REQUEST_H
+#define _REQUEST_H
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <libxml/parser.h>
+
+// Collectors keep 8 tiers of samples, a samples list never names more
+#define REQUEST_MAX_TIERS 8
+
+// An <x> element of a stat that has several items, such as network interfaces
+class RequestEntry
+{
+	public:
+		RequestEntry() : hasKeys(false) {}
+
+		// Whether _key is one of the requested keys, a hash lookup
+		bool has_key(const std::string &_key) const;
+
+		// Rebuilds the hash table has_key() uses, called whenever keys changes
+		void index_keys();
+
+		std::vector<double> samples;
+		std::vector<std::string> keys;
+		bool hasKeys;
+
+	private:
+		// Open addressing table of positions in keys plus one, 0 marks a free slot
+		std::vector<unsigned int> keySlots;
+};
+
+// An <i> element, one stat type the client wants samples of
+class RequestItem
+{
+	public:
+		std::string type;
+		std::vector<double> samples;
+		std::vector<RequestEntry> entries;
+};
+
+// A parsed <isr> request. Requests are tiny, flat and always shaped the same,
+// so they are read by a small pull parser straight into these fields. Only
+// input it does not expect, such as entities or comments, goes through libxml.
+//
+// A connection keeps one Request and parses every request into it, the
+// strings and vectors keep their capacity so steady polling allocates nothing.
+class Request
+{
+	public:
+		Request() : type(0), context(NULL) {}
+		Request(const Request &_other);
+		Request & operator = (const Request &_other);
+		~Request();
+
+		// Returns 1 when _data held an <isr> request, 0 when it should be ignored
+		int parse(const char *_data, size_t _length);
+
+		// Exchanges the parsed fields, the libxml parser stays with each object
+		void swap(Request &_other);
+
+		int type;
+		std::string protocol;
+		std::string uuid;
+		std::string name;
+		std::string version;
+		std::string code;
+		std::vector<RequestItem> items;
+
+	private:
+		int parse_fast(const char *_data, size_t _length);
+		int parse_document(const char *_data, size_t _length);
+		void reset();
+
+		xmlParserCtxtPtr context;
+};
+
+#endif
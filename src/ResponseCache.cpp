@@ -0,0 +1,156 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <list>
+#include <sstream>
+#include <pthread.h>
+
+#include "ResponseCache.h"
+#include "Utility.h"
+
+using namespace std;
+
+struct cached_response
+{
+	unsigned long long hash;
+	string key;
+	string header;
+	ResponseData data;
+	size_t bytes;
+};
+
+// Most recently used first
+static list<cached_response> cachedResponses;
+static size_t cacheCapacity = 0;
+static size_t cacheByteLimit = 0;
+static size_t cacheBytes = 0;
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long long cacheHits = 0;
+static unsigned long long cacheMisses = 0;
+
+// Drops the least recently used entries until _entries more and _bytes more fit, called with cacheLock held
+static void make_room(size_t _entries, size_t _bytes)
+{
+	while (!cachedResponses.empty() && (cachedResponses.size() + _entries > cacheCapacity || cacheBytes + _bytes > cacheByteLimit))
+	{
+		cacheBytes -= cachedResponses.back().bytes;
+		cachedResponses.pop_back();
+	}
+}
+
+void InitResponseCache(size_t _entries, size_t _bytes)
+{
+	pthread_mutex_lock(&cacheLock);
+	cacheCapacity = _entries;
+	cacheByteLimit = _bytes;
+	make_room(0, 0);
+	pthread_mutex_unlock(&cacheLock);
+}
+
+int FindCachedResponse(const string &_key, string &_header, ResponseData &_data)
+{
+	unsigned long long hash = hash_bytes(_key.data(), _key.size());
+	int found = 0;
+
+	pthread_mutex_lock(&cacheLock);
+	if (cacheCapacity > 0)
+	{
+		for (list<cached_response>::iterator cur = cachedResponses.begin(); cur != cachedResponses.end(); ++cur)
+		{
+			if (cur->hash != hash || cur->key != _key)
+				continue;
+
+			// The payload is shared, not copied
+			_header = cur->header;
+			_data = cur->data;
+			cachedResponses.splice(cachedResponses.begin(), cachedResponses, cur);
+			found = 1;
+			break;
+		}
+
+		if (found)
+			cacheHits++;
+		else
+			cacheMisses++;
+	}
+	pthread_mutex_unlock(&cacheLock);
+
+	return found;
+}
+
+void CacheResponse(const string &_key, const string &_header, const ResponseData &_data)
+{
+	unsigned long long hash = hash_bytes(_key.data(), _key.size());
+	size_t bytes = _key.size() + _header.size() + _data.size();
+
+	// One large response would push out many small ones
+	if (bytes > RESPONSE_CACHE_ENTRY_LIMIT)
+		return;
+
+	pthread_mutex_lock(&cacheLock);
+	if (cacheCapacity > 0 && bytes <= cacheByteLimit)
+	{
+		// Another worker may have answered the same request in the meantime
+		for (list<cached_response>::iterator cur = cachedResponses.begin(); cur != cachedResponses.end(); ++cur)
+		{
+			if (cur->hash == hash && cur->key == _key)
+			{
+				pthread_mutex_unlock(&cacheLock);
+				return;
+			}
+		}
+
+		make_room(1, bytes);
+		cachedResponses.push_front(cached_response());
+
+		cached_response &entry = cachedResponses.front();
+		entry.hash = hash;
+		entry.key = _key;
+		entry.header = _header;
+		entry.data = _data;
+		entry.bytes = bytes;
+		cacheBytes += bytes;
+	}
+	pthread_mutex_unlock(&cacheLock);
+}
+
+string ResponseCacheReport()
+{
+	stringstream report;
+
+	pthread_mutex_lock(&cacheLock);
+	report << "Response cache: " << cacheHits << " hits, " << cacheMisses << " misses, " << cachedResponses.size() << "/" << cacheCapacity << " entries, " << cacheBytes << "/" << cacheByteLimit << " bytes";
+	pthread_mutex_unlock(&cacheLock);
+
+	return report.str();
+}
@@ -0,0 +1,106 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _RESPONSEDATA_H
+#define _RESPONSEDATA_H
+
+#include <stddef.h>
+#include <string>
+#include <deque>
+
+// Chunks shared between copies of a ResponseData
+class ResponseBuffer
+{
+	public:
+		ResponseBuffer() : references(1) {}
+
+		int references;
+		std::deque<std::string> chunks;
+};
+
+// Payload of a response in chunks written one after the other. Copies share the
+// chunks, so a response can sit in the cache and in any number of connections'
+// output without being copied. Reference counts are atomic, but the chunks may
+// only be changed through the one copy that built them, before it is shared.
+class ResponseData
+{
+	public:
+		ResponseData() : buffer(NULL) {}
+		ResponseData(const ResponseData &_other) : buffer(_other.buffer)
+		{
+			if (buffer)
+				__atomic_add_fetch(&buffer->references, 1, __ATOMIC_RELAXED);
+		}
+
+		~ResponseData() { release(); }
+
+		ResponseData & operator = (const ResponseData &_other)
+		{
+			if (_other.buffer)
+				__atomic_add_fetch(&_other.buffer->references, 1, __ATOMIC_RELAXED);
+			release();
+			buffer = _other.buffer;
+			return *this;
+		}
+
+		// Chunks to build the response into
+		std::deque<std::string> & chunks()
+		{
+			if (buffer == NULL)
+				buffer = new ResponseBuffer();
+			return buffer->chunks;
+		}
+
+		size_t count() const { return buffer ? buffer->chunks.size() : 0; }
+		const std::string & operator [] (size_t i) const { return buffer->chunks[i]; }
+
+		size_t size() const
+		{
+			size_t length = 0;
+			for (size_t i = 0; i < count(); i++)
+				length += buffer->chunks[i].size();
+			return length;
+		}
+
+		void clear() { release(); }
+
+	private:
+		void release()
+		{
+			if (buffer && __atomic_sub_fetch(&buffer->references, 1, __ATOMIC_ACQ_REL) == 0)
+				delete buffer;
+			buffer = NULL;
+		}
+
+		ResponseBuffer *buffer;
+};
+
+#endif
@@ -40,55 +40,40 @@
 #include "Responses.h"
 #include "Stats.h"
 #include "Utility.h"
+#include "OutputBuffer.h"
 
 using namespace std;
 
-string encodeForXml(string sSrc)
+// Keys of the process rankings, AddedItems keeps pointers to them
+static const string processCpuKey = "cpu";
+static const string processMemoryKey = "memory";
+
+// Escapes text as it is written to an OutputBuffer
+EscapedXml encodeForXml(const string &text)
+{
+	return EscapedXml(text);
+}
+
+EscapedXml encodeForXml(const char *text)
 {
-    ostringstream sRet;
-
-    for( string::const_iterator iter = sSrc.begin(); iter!=sSrc.end(); iter++ )
-    {
-         unsigned char c = (unsigned char)*iter;
-
-         switch( c )
-         {
-             case '&': sRet << "&amp;"; break;
-             case '<': sRet << "&lt;"; break;
-             case '>': sRet << "&gt;"; break;
-             case '"': sRet << "&quot;"; break;
-             case '\'': sRet << "&apos;"; break;
-
-             default:
-              if ( c<32 || c>127 )
-              {
-                   sRet << "&#" << (unsigned int)c << ";";
-              }
-              else
-              {
-                   sRet << c;
-              }
-         }
-    }
-
-    return sRet.str();
+	return EscapedXml(text);
 }
 
-string isr_create_header()
+const char * isr_create_header()
 {
 	return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
 }
 
 string isr_accept_code()
 {
-	stringstream temp;
+	OutputBuffer temp;
 	temp << isr_create_header() << "<isr type=\"103\"></isr>";
 	return temp.str();
 }
 
 string isr_reject_code()
 {
-	stringstream temp;
+	OutputBuffer temp;
 	temp << isr_create_header() << "<isr type=\"102\"></isr>";
 	return temp.str();
 }
@@ -101,171 +86,217 @@ string isr_serverinfo(int session, int auth, string uuid, bool historyEnabled)
 		history = 1;
 	#endif
 
-	stringstream temp;
+	OutputBuffer temp;
 	temp << isr_create_header() << "<isr type=\"101\" build=\""<< SERVER_BUILD << "\" version=\""<< SERVER_VERSION << "\" history=\""<< history << "\" protocol=\""<< PROTOCOL_VERSION << "\" platform=\"" << serverPlatform() << "\" session=\"" << session << "\" uuid=\"" << uuid << "\" auth=\"" << auth << "\"></isr>";
 	return temp.str();
 }
 
-string isr_accept_connection()
+void isr_stats_data(OutputBuffer &output, const Request &request, const StatsSnapshot *snapshot, bool authenticated)
 {
-	stringstream temp;
-	temp << isr_create_header() << "<isr type=\"100\" protocol=\"" << PROTOCOL_VERSION << "\" sec=\"1\"></isr>";
-	return temp.str();
+	output << isr_create_header() << "<isr type=\"104\">";
+	if (authenticated)
+	{
+		for (vector<RequestItem>::const_iterator child = request.items.begin(); child != request.items.end(); ++child)
+		{
+			const char *type = child->type.c_str();
+			if(strcmp(type, "cpu") == 0)
+			{
+				isr_cpu_data(output, *child, snapshot);
+			}
+			if(strcmp(type, "memory") == 0)
+			{
+				isr_memory_data(output, *child, snapshot);
+			}
+			if(strcmp(type, "load") == 0)
+			{
+				isr_loadavg_data(output, *child, snapshot);
+			}
+			if(strcmp(type, "network") == 0)
+			{
+				#ifndef USE_NET_NONE
+				isr_multiple_data(output, *child, snapshot);
+				#endif
+			}
+			if(strcmp(type, "diskactivity") == 0)
+			{
+				#ifndef USE_ACTIVITY_NONE
+				isr_multiple_data(output, *child, snapshot);
+				#endif
+			}
+			if(strcmp(type, "processes") == 0)
+			{
+				#ifndef USE_PROCESSES_NONE
+				isr_multiple_data(output, *child, snapshot);
+				#endif
+			}
+			if(strcmp(type, "disks") == 0)
+			{
+				#ifndef USE_DISK_NONE
+				isr_multiple_data(output, *child, snapshot);
+				#endif
+			}
+			if(strcmp(type, "sensors") == 0)
+			{
+				isr_multiple_data(output, *child, snapshot);
+			}
+			if(strcmp(type, "uptime") == 0)
+			{
+				isr_uptime_data(output, snapshot->uptime);
+			}
+			if(strcmp(type, "battery") == 0)
+			{
+				#ifndef USE_BATTERY_NONE
+				isr_multiple_data(output, *child, snapshot);
+				#endif
+			}
+		}
+	}
+
+	output << "</isr>";
 }
 
-string isr_cpu_data(xmlNodePtr node, Stats *stats)
+// Appends a request field prefixed with its length, so no two requests share a key
+static void fingerprint_field(OutputBuffer &key, const char *value, size_t length)
 {
-	#ifdef USE_CPU_NONE
-	return "";
-	#endif
+	key << length << ':';
+	key.append(value, length);
+}
+
+// Sample ids are appended as their bytes, printing them could round two ids to the same text
+static void fingerprint_samples(OutputBuffer &key, const vector<double> &samples)
+{
+	if (samples.empty())
+		fingerprint_field(key, "", 0);
+	else
+		fingerprint_field(key, (const char *)&samples[0], samples.size() * sizeof(double));
+}
+
+static unsigned long long collector_generation(const char *type, const StatsSnapshot *snapshot)
+{
+	if(strcmp(type, "cpu") == 0)
+		return snapshot->cpu.generation + snapshot->processes.generation;
+	if(strcmp(type, "memory") == 0)
+		return snapshot->memory.generation;
+	if(strcmp(type, "load") == 0)
+		return snapshot->load.generation;
+	if(strcmp(type, "network") == 0)
+		return snapshot->network.generation;
+	if(strcmp(type, "diskactivity") == 0)
+		return snapshot->activity.generation;
+	if(strcmp(type, "processes") == 0)
+		return snapshot->processes.generation;
+	if(strcmp(type, "disks") == 0)
+		return snapshot->disks.generation;
+	if(strcmp(type, "sensors") == 0)
+		return snapshot->sensors.generation;
+	if(strcmp(type, "battery") == 0)
+		return snapshot->battery.generation;
+	if(strcmp(type, "uptime") == 0)
+		return snapshot->uptime;
+	return 0;
+}
 
-	stringstream output;
+void isr_request_fingerprint(OutputBuffer &key, const Request &request, const StatsSnapshot *snapshot, bool authenticated)
+{
+	// Everything isr_stats_data() reads from the request, followed by the
+	// generation of each collector it reads from. A new sample changes the key.
+	key << (authenticated ? "a;" : "u;");
+	if (!authenticated)
+		return;
 
-	char *identifiers = (char *)xmlGetProp(node, (const xmlChar *)"samples");
-	vector<string> identifierItems = explode(string(identifiers), "|");
-	for(uint x = 0;x < identifierItems.size(); x++)
+	for (vector<RequestItem>::const_iterator child = request.items.begin(); child != request.items.end(); ++child)
 	{
-		double sampleID = to_double(identifierItems[x].c_str());
+		fingerprint_field(key, child->type.data(), child->type.size());
+		fingerprint_samples(key, child->samples);
 
-		deque<cpu_data> samples;
-		for(size_t i = 0;i < stats->cpuStats.samples[x].size(); i++)
+		for (vector<RequestEntry>::const_iterator entry = child->entries.begin(); entry != child->entries.end(); ++entry)
 		{
-			cpu_data sample = stats->cpuStats.samples[x][i];
-			if (sample.sampleID > sampleID)
+			fingerprint_samples(key, entry->samples);
+			if (entry->hasKeys)
 			{
-				samples.push_front(sample);
+				key << entry->keys.size() << 'k';
+				for (vector<string>::const_iterator name = entry->keys.begin(); name != entry->keys.end(); ++name)
+					fingerprint_field(key, name->data(), name->size());
 			}
 			else
-				break;
+			{
+				key << "-;";
+			}
 		}
 
-		output << "<stat type=\"cpu\" interval=\"" << x << "\" session=\"" << stats->cpuStats.session << "\" id=\"" << stats->cpuStats.sampleIndex[x].sampleID << "\" threads=\"" << stats->processStats.threadCount << "\" tasks=\"" << stats->processStats.processCount << "\" samples=\"" << samples.size() << "\">";
-		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct cpu_data sample = samples[i];	
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" u=\"" << sample.u << "\" s=\"" << sample.s << "\" n=\"" << sample.n << "\" io=\"" << sample.io << "\"";
-		
-			#ifdef USE_CPU_PERFSTAT
-			if(stats->cpuStats.hasLpar)
-				output << " ent=\"" << sample.ent << "\" phys=\"" << sample.phys << "\"";
-			#endif
-
-			output << "></s>";
-		}
-		output << "</stat>";
+		key << '@' << collector_generation(child->type.c_str(), snapshot) << ';';
 	}
-	free(identifiers);
+}
 
-	return output.str();
+string isr_stats_header(size_t length, bool compressed)
+{
+	OutputBuffer temp;
+	temp << isr_create_header() << "<isr type=\"105\" length=\"" << length << "\"";
+	if(compressed)
+		temp << " c=\"1\"";
+	temp << "></isr>";
+	return temp.str();
 }
 
-string isr_memory_data(xmlNodePtr node, Stats *stats)
+string isr_accept_connection()
 {
-	#ifdef USE_MEM_NONE
-	return "";
-	#endif
+	OutputBuffer temp;
+	temp << isr_create_header() << "<isr type=\"100\" protocol=\"" << PROTOCOL_VERSION << "\" sec=\"1\"></isr>";
+	return temp.str();
+}
 
-	stringstream output;
+void isr_cpu_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot)
+{
+	#ifdef USE_CPU_NONE
+	return;
+	#endif
 
-	char *identifiers = (char *)xmlGetProp(node, (const xmlChar *)"samples");
-	vector<string> identifierItems = explode(string(identifiers), "|");
-	for(uint x = 0;x < identifierItems.size(); x++)
+	for(uint x = 0;x < item.samples.size(); x++)
 	{
-		double sampleID = to_double(identifierItems[x].c_str());
+		double sampleID = item.samples[x];
 
-		deque<mem_data> samples;
-		for(size_t i = 0;i < stats->memoryStats.samples[x].size(); i++)
-		{
-			mem_data sample = stats->memoryStats.samples[x][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<cpu_data> samples(snapshot->cpu.samples[x], sampleID);
 
-		output << "<stat type=\"memory\" interval=\"" << x << "\" session=\"" << stats->memoryStats.session << "\" id=\"" << stats->memoryStats.sampleIndex[x].sampleID << "\" samples=\"" << samples.size() << "\">";
+		output << "<stat type=\"cpu\" interval=\"" << x << "\" session=\"" << snapshot->cpu.session << "\" id=\"" << snapshot->cpu.sampleIDs[x] << "\" threads=\"" << snapshot->processes.threadCount << "\" tasks=\"" << snapshot->processes.processCount << "\" samples=\"" << samples.size() << "\">";
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct mem_data mem = samples[i];	
-			output << "<s id=\"" << mem.sampleID << "\" time=\"" << (long long)mem.time << "\"";
-
-			if(mem.values[memory_value_file] >= 0)
-				output << " file=\"" << mem.values[memory_value_file] << "\"";
-			if(mem.values[memory_value_ex] >= 0)
-			  	output << " ex=\"" << mem.values[memory_value_ex] << "\"";
-			if(mem.values[memory_value_buffer] >= 0)
-				output << " buf=\"" << mem.values[memory_value_buffer] << "\"";
-			if(mem.values[memory_value_used] >= 0)
-				output << " u=\"" << mem.values[memory_value_used] << "\"";
-			if(mem.values[memory_value_wired] >= 0)
-				output << " w=\"" << mem.values[memory_value_wired] << "\"";
-			if(mem.values[memory_value_cached] >= 0)
-				output << " ca=\"" << mem.values[memory_value_cached] << "\"";
-			if(mem.values[memory_value_active] >= 0)
-				output << " a=\"" << mem.values[memory_value_active] << "\"";
-			if(mem.values[memory_value_inactive] >= 0)
-				output << " i=\"" << mem.values[memory_value_inactive] << "\"";
-			if(mem.values[memory_value_free] >= 0)
-				output << " f=\"" << mem.values[memory_value_free] << "\"";
-			if(mem.values[memory_value_total] >= 0)
-				output << " t=\"" << mem.values[memory_value_total] << "\"";
-			if(mem.values[memory_value_swapused] >= 0)
-				output << " su=\"" << mem.values[memory_value_swapused]  << "\"";
-			if(mem.values[memory_value_swaptotal] >= 0)
-				output << " st=\"" << mem.values[memory_value_swaptotal] << "\"";
-			if(mem.values[memory_value_swapin] >= 0)
-				output << " pi=\"" << mem.values[memory_value_swapin] << "\"";
-			if(mem.values[memory_value_swapin] >= 0)
-				output << " po=\"" << mem.values[memory_value_swapout] << "\"";
-			if(mem.values[memory_value_virtualtotal] >= 0)
-				output << " vt=\"" << mem.values[memory_value_virtualtotal] << "\"";
-			if(mem.values[memory_value_virtualactive] >= 0)
-				output << " va=\"" << mem.values[memory_value_virtualactive] << "\"";
-
-			output << "></s>";
-		}
+			output << samples[i].xml;
 		output << "</stat>";
 	}
-	free(identifiers);
-
-	return output.str();
 }
 
-string keyForIndex(string uuid, int index)
+void isr_memory_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot)
 {
-	stringstream skey;
-	skey << index << ":" << uuid;
-	string key = skey.str();
-	return key;
+	#ifdef USE_MEM_NONE
+	return;
+	#endif
+
+	for(uint x = 0;x < item.samples.size(); x++)
+	{
+		double sampleID = item.samples[x];
+
+		SampleRange<mem_data> samples(snapshot->memory.samples[x], sampleID);
+
+		output << "<stat type=\"memory\" interval=\"" << x << "\" session=\"" << snapshot->memory.session << "\" id=\"" << snapshot->memory.sampleIDs[x] << "\" samples=\"" << samples.size() << "\">";
+		for(size_t i = 0;i < samples.size(); i++)
+			output << samples[i].xml;
+		output << "</stat>";
+	}
 }
 
-string isr_network_data(int index, long sampleID, StatsNetwork stats, vector<string> keys, vector<string> *added)
+void isr_network_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<network_info> &stats, const RequestEntry &entry, AddedItems *added)
 {
-	stringstream output;
-	output << "<stat type=\"network\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIndex[index].sampleID << "\">";
+	output << "<stat type=\"network\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIDs[index] << "\">";
 
-	for(size_t itemindex = 0;itemindex < stats._items.size(); itemindex++)
+	for(size_t itemindex = 0;itemindex < stats.items.size(); itemindex++)
 	{
-		network_info item = stats._items[itemindex];
+		const network_info &item = stats.items[itemindex];
 		if(!item.active)
 			continue;
 
-		if(!shouldAddKey(index, item.device, keys, added))
+		if(!shouldAddKey(index, item.device, entry, added))
 			continue;
 
-		deque<net_data> samples;
-		for(size_t i = 0;i < item.samples[index].size(); i++)
-		{
-			net_data sample = item.samples[index][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<net_data> samples(item.samples[index], sampleID);
 
 		output << "<item uuid=\"" << encodeForXml(item.device) << "\" samples=\"" << samples.size() << "\"";
 		if(index == 0)
@@ -283,119 +314,114 @@ string isr_network_data(int index, long sampleID, StatsNetwork stats, vector<str
 		output << ">";
 
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct net_data sample = samples[i];	
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" d=\"" << sample.d << "\" u=\"" << sample.u << "\"></s>";
-		}
+			output << samples[i].xml;
 		output << "</item>";
 	}
 	output << "</stat>";
+}
+
+// Whether the item with this key goes into the response.
+// Keys are looked up in the entry's hash table.
+bool shouldAddKey(int index, const string &key, const RequestEntry &entry, AddedItems *added)
+{
+	if(entry.keys.size() > 0 && !entry.has_key(key))
+		return false;
 
-	return output.str();
+	return added->insert(index, key);
 }
 
-bool shouldAddKey(int index, string key, vector<string> keys, vector<string> *added)
+bool AddedItems::insert(int _index, const string &_key)
 {
-	bool add = true;
-	string k = keyForIndex(key, index);
-			
-	for(size_t i = 0;i < added->size(); i++)
-	{
-		if(added->at(i) == k)
-		{
-			add = false;
-			break;
-		}
-	}
-	if(add == true && keys.size() > 0)
-	{
-		add = false;
-		for(size_t i = 0;i < keys.size(); i++)
-		{
-			if(keys[i] == key)
-			{
-				add = true;
-				break;
-			}
-		}
-	}
-	if(add == true)
+	// One bit per tier, collectors keep 8 of them
+	if (_index < 0 || _index >= 8)
+		return false;
+
+	// Kept at most half full
+	if ((used + 1) * 2 > slots.size())
+		grow();
+
+	unsigned long long hash = hash_bytes(_key.data(), _key.size());
+	size_t mask = slots.size() - 1;
+	size_t slot = hash & mask;
+	while (slots[slot].key != NULL && (slots[slot].hash != hash || *slots[slot].key != _key))
+		slot = (slot + 1) & mask;
+
+	if (slots[slot].key == NULL)
 	{
-		added->push_back(k);
+		slots[slot].key = &_key;
+		slots[slot].hash = hash;
+		used++;
 	}
 
-	return add;
+	if (slots[slot].tiers & (1 << _index))
+		return false;
+
+	slots[slot].tiers |= 1 << _index;
+	return true;
 }
 
-string isr_multiple_data(xmlNodePtr node, Stats *stats)
+void AddedItems::grow()
 {
-	stringstream output;
-	vector<string> addedKeys;
+	vector<Slot> old;
+	old.swap(slots);
+	slots.resize(old.empty() ? 64 : old.size() * 2);
 
-	char *type = (char *)xmlGetProp(node, (const xmlChar *)"type");
-	xmlNodePtr child = node->children;
-	while (child){
-		char *identifiers = (char *)xmlGetProp(child, (const xmlChar *)"samples");
-		char *keys = (char *)xmlGetProp(child, (const xmlChar *)"keys");
+	size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < old.size(); i++)
+	{
+		if (old[i].key == NULL)
+			continue;
+
+		size_t slot = old[i].hash & mask;
+		while (slots[slot].key != NULL)
+			slot = (slot + 1) & mask;
+		slots[slot] = old[i];
+	}
+}
+
+void isr_multiple_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot)
+{
+	AddedItems addedKeys;
 
-		vector<string> identifierItems = explode(string(identifiers), "|");
-		vector<string> keyItems;
-		if(keys != NULL)
-			 keyItems = explode(string(keys), "|");
+	const char *type = item.type.c_str();
+	for (vector<RequestEntry>::const_iterator child = item.entries.begin(); child != item.entries.end(); ++child)
+	{
+		const RequestEntry &keyItems = *child;
 
-		for(uint x = 0;x < identifierItems.size(); x++)
+		for(uint x = 0;x < child->samples.size(); x++)
 		{
-			double sampleID = to_double(identifierItems[x].c_str());
+			double sampleID = child->samples[x];
 
 			if(strcmp(type, "network") == 0)
-				output << isr_network_data(x, sampleID, stats->networkStats, keyItems, &addedKeys);
+				isr_network_data(output, x, sampleID, snapshot->network, keyItems, &addedKeys);
 			else if(strcmp(type, "diskactivity") == 0)
-				output << isr_activity_data(x, sampleID, stats->activityStats, keyItems, &addedKeys);
+				isr_activity_data(output, x, sampleID, snapshot->activity, keyItems, &addedKeys);
 			else if(strcmp(type, "sensors") == 0)
-				output << isr_sensor_data(x, sampleID, stats->sensorStats, keyItems, &addedKeys);
+				isr_sensor_data(output, x, sampleID, snapshot->sensors, keyItems, &addedKeys);
 			else if(strcmp(type, "disks") == 0)
-				output << isr_disk_data(x, sampleID, stats->diskStats, keyItems, &addedKeys);
+				isr_disk_data(output, x, sampleID, snapshot->disks, keyItems, &addedKeys);
 			else if(strcmp(type, "processes") == 0)
-				output << isr_process_data(x, sampleID, stats->processStats, keyItems, &addedKeys);
+				isr_process_data(output, x, sampleID, snapshot->processes, keyItems, &addedKeys);
 			else if(strcmp(type, "battery") == 0)
-				output << isr_battery_data(x, sampleID, stats->batteryStats, keyItems, &addedKeys);
+				isr_battery_data(output, x, sampleID, snapshot->battery, keyItems, &addedKeys);
 		}
-
-		if(keys != NULL)
-			free(keys);
-
-		free(identifiers);
-		child = child->next;
 	}
-	free(type);
-	return output.str();
 }
 
-string isr_activity_data(int index, long sampleID, StatsActivity stats, vector<string> keys, vector<string> *added)
+void isr_activity_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<activity_info> &stats, const RequestEntry &entry, AddedItems *added)
 {
-	stringstream output;
-	output << "<stat type=\"diskactivity\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIndex[index].sampleID << "\">";
+	output << "<stat type=\"diskactivity\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIDs[index] << "\">";
 
-	for(size_t itemindex = 0;itemindex < stats._items.size(); itemindex++)
+	for(size_t itemindex = 0;itemindex < stats.items.size(); itemindex++)
 	{
-		activity_info item = stats._items[itemindex];
+		const activity_info &item = stats.items[itemindex];
 		if(!item.active)
 			continue;
 
-		if(!shouldAddKey(index, item.device, keys, added))
+		if(!shouldAddKey(index, item.device, entry, added))
 			continue;
 
-		deque<activity_data> samples;
-		for(size_t i = 0;i < item.samples[index].size(); i++)
-		{
-			activity_data sample = item.samples[index][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<activity_data> samples(item.samples[index], sampleID);
 
 		output << "<item uuid=\"" << encodeForXml(item.device) << "\" samples=\"" << samples.size() << "\"";
 		if(index == 0)
@@ -420,211 +446,121 @@ string isr_activity_data(int index, long sampleID, StatsActivity stats, vector<s
 		output << ">";
 
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct activity_data sample = samples[i];	
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" r=\"" << sample.r << "\" w=\"" << sample.w << "\"></s>";
-		}
+			output << samples[i].xml;
 		output << "</item>";
 	}
 	output << "</stat>";
-
-	return output.str();
 }
 
-string isr_disk_data(int index, long sampleID, StatsDisks stats, vector<string> keys, vector<string> *added)
+void isr_disk_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<disk_info> &stats, const RequestEntry &entry, AddedItems *added)
 {
-	stringstream output;
-	output << "<stat type=\"disks\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIndex[index].sampleID << "\">";
+	output << "<stat type=\"disks\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIDs[index] << "\">";
 
-	for(size_t itemindex = 0;itemindex < stats._items.size(); itemindex++)
+	for(size_t itemindex = 0;itemindex < stats.items.size(); itemindex++)
 	{
-		disk_info item = stats._items[itemindex];
+		const disk_info &item = stats.items[itemindex];
 		if(!item.active)
 			continue;
 
-		if(!shouldAddKey(index, item.key, keys, added))
+		if(!shouldAddKey(index, item.key, entry, added))
 			continue;
 
-		deque<disk_data> samples;
-		for(size_t i = 0;i < item.samples[index].size(); i++)
-		{
-			disk_data sample = item.samples[index][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<disk_data> samples(item.samples[index], sampleID);
 
 		output << "<item bsd=\"" << encodeForXml(item.key) << "\" uuid=\"" << item.uuid << "\" name=\"" << encodeForXml(item.displayName) << "\" samples=\"" << samples.size() << "\">";
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct disk_data sample = samples[i];	
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" f=\"" << sample.f << "\" u=\"" << sample.u << "\" s=\"" << sample.t << "\" p=\"" << sample.p << "\"></s>";
-		}
+			output << samples[i].xml;
 		output << "</item>";
 	}
 	output << "</stat>";
-
-	return output.str();
 }
 
-string isr_uptime_data(long uptime)
+void isr_uptime_data(OutputBuffer &output, long uptime)
 {
 	#ifdef USE_UPTIME_NONE
-	return "";
+	return;
 	#endif
 
-	stringstream temp;
-	temp << "<stat type=\"uptime\" u=\"" << uptime << "\"></stat>";
-	return temp.str();
+	output << "<stat type=\"uptime\" u=\"" << uptime << "\"></stat>";
 }
 
-string isr_loadavg_data(xmlNodePtr node, Stats *stats)
+void isr_loadavg_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot)
 {
 	#ifdef USE_LOAD_NONE
-	return "";
+	return;
 	#endif
 
-	stringstream output;
-
-	char *identifiers = (char *)xmlGetProp(node, (const xmlChar *)"samples");
-	vector<string> identifierItems = explode(string(identifiers), "|");
-	for(uint x = 0;x < identifierItems.size(); x++)
+	for(uint x = 0;x < item.samples.size(); x++)
 	{
-		double sampleID = to_double(identifierItems[x].c_str());
+		double sampleID = item.samples[x];
 
-		deque<load_data> samples;
-		for(size_t i = 0;i < stats->loadStats.samples[x].size(); i++)
-		{
-			load_data sample = stats->loadStats.samples[x][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<load_data> samples(snapshot->load.samples[x], sampleID);
 
-		output << "<stat type=\"load\" interval=\"" << x << "\" session=\"" << stats->loadStats.session << "\" id=\"" << stats->loadStats.sampleIndex[x].sampleID << "\" samples=\"" << samples.size() << "\">";
+		output << "<stat type=\"load\" interval=\"" << x << "\" session=\"" << snapshot->load.session << "\" id=\"" << snapshot->load.sampleIDs[x] << "\" samples=\"" << samples.size() << "\">";
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			load_data sample = samples[i];
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" one=\"" << sample.one << "\" five=\"" << sample.two << "\" fifteen=\"" << sample.three << "\"></s>";
-		}
+			output << samples[i].xml;
 		output << "</stat>";
 	}
-	free(identifiers);
-
-	return output.str();
 }
 
-string isr_sensor_data(int index, long sampleID, StatsSensors stats, vector<string> keys, vector<string> *added)
+void isr_sensor_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<sensor_info> &stats, const RequestEntry &entry, AddedItems *added)
 {
-	stringstream output;
-	output << "<stat type=\"sensors\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIndex[index].sampleID << "\" partial=\"1\">";
+	output << "<stat type=\"sensors\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIDs[index] << "\" partial=\"1\">";
 
-	for(size_t itemindex = 0;itemindex < stats._items.size(); itemindex++)
+	for(size_t itemindex = 0;itemindex < stats.items.size(); itemindex++)
 	{
-		sensor_info item = stats._items[itemindex];
-		if(!shouldAddKey(index, item.key, keys, added))
+		const sensor_info &item = stats.items[itemindex];
+		if(!shouldAddKey(index, item.key, entry, added))
 			continue;
 
-		deque<sensor_data> samples;
-		for(size_t i = 0;i < item.samples[index].size(); i++)
-		{
-			sensor_data sample = item.samples[index][i];
-			if (sample.sampleID > sampleID)
-			{
-				samples.push_front(sample);
-			}
-			else
-				break;
-		}
+		SampleRange<sensor_data> samples(item.samples[index], sampleID);
 
 		output << "<item low=\"" << item.lowestValue << "\" high=\"" << item.highestValue << "\" uuid=\"" << item.key << "\" name=\"" << encodeForXml(item.label) << "\" type=\"" << item.kind << "\" samples=\"" << samples.size() << "\">";
 		for(size_t i = 0;i < samples.size(); i++)
-		{
-			struct sensor_data sample = samples[i];	
-			output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" v=\"" << sample.value << "\"></s>";
-		}
+			output << samples[i].xml;
 		output << "</item>";
 	}
 	output << "</stat>";
-
-	return output.str();
 }
 
-string isr_battery_data(int index, long sampleID, StatsBattery stats, vector<string> keys, vector<string> *added)
+void isr_battery_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<battery_info> &stats, const RequestEntry &entry, AddedItems *added)
 {
-	stringstream output;
-	output << "<stat type=\"battery\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIndex[index].sampleID << "\">";
+	output << "<stat type=\"battery\" interval=\"" << index << "\" session=\"" << stats.session << "\" id=\"" << stats.sampleIDs[index] << "\">";
 
-	for(size_t itemindex = 0;itemindex < stats._items.size(); itemindex++)
+	for(size_t itemindex = 0;itemindex < stats.items.size(); itemindex++)
 	{
-		battery_info item = stats._items[itemindex];
-		if(!shouldAddKey(index, item.key, keys, added))
+		const battery_info &item = stats.items[itemindex];
+		if(!shouldAddKey(index, item.key, entry, added))
 			continue;
 
 		output << "<item uuid=\"" << item.key << "\" health=\"" << item.health << "\" time=\"" << item.timeRemaining << "\" cycles=\"" << item.cycles << "\" state=\"" << item.state << "\" source=\"" << item.source << "\" percentage=\"" << item.percentage << "\">";
 		output << "</item>";
 	}
 	output << "</stat>";
-
-	return output.str();
 }
 
-bool sortProcessesCPU (process_info i,process_info j) { return (j.cpu<i.cpu); }
-bool sortProcessesMemory (process_info i,process_info j) { return (j.memory<i.memory); }
-bool sortProcessesIORead (process_info i,process_info j) { return (j.io_read<i.io_read); }
-bool sortProcessesIOWrite (process_info i,process_info j) { return (j.io_write<i.io_write); }
-
-string isr_process_data(int index, long sampleID, StatsProcesses stats, vector<string> keys, vector<string> *added)
+void isr_process_data(OutputBuffer &output, int index, long sampleID, const ProcessesSnapshot &stats, const RequestEntry &entry, AddedItems *added)
 {
-	vector<process_info> _history;
-
-	if(stats._items.size() > 0)
-	{
-		for (vector<process_info>::iterator cur = stats._items.begin(); cur != stats._items.end(); ++cur)
-		{
-			process_info temp = *cur;
-			_history.push_back(temp);
-		}
-	}
-
-	stringstream output;
-
-	if(_history.size() > 0)
+	if(stats.cpu.size() > 0)
 	{
-		output << "<stat type=\"processes\" interval=\"0\" id=\"" << _history.back().sampleID << "\">";
+		output << "<stat type=\"processes\" interval=\"0\" id=\"" << stats.sampleID << "\">";
 	
-		if(shouldAddKey(0, "cpu", keys, added))
+		if(shouldAddKey(0, processCpuKey, entry, added))
 		{
-			std::sort (_history.begin(), _history.end(), sortProcessesCPU);
-			int count = 0;
-
-			for (vector<process_info>::iterator cur = _history.begin(); cur != _history.end(); ++cur)
+			for (size_t i = 0; i < stats.cpu.size(); i++)
 			{
-				output << "<item key=\"" << cur->pid << "\" c=\"" << cur->cpu << "\" name=\"" << encodeForXml(string(cur->name)) << "\"></item>";
-				count++;
-				if(count == 20)
-					break;
+				const process_info *cur = &stats.cpu[i];
+				output << "<item key=\"" << cur->pid << "\" c=\"" << cur->cpu << "\" name=\"" << encodeForXml(cur->name) << "\"></item>";
 			}
 
 		}
 
-		if(shouldAddKey(0, "memory", keys, added))
+		if(shouldAddKey(0, processMemoryKey, entry, added))
 		{
-			int count = 0;
-			std::sort (_history.begin(), _history.end(), sortProcessesMemory);
-	
-			for (vector<process_info>::iterator cur = _history.begin(); cur != _history.end(); ++cur)
+			for (size_t i = 0; i < stats.memory.size(); i++)
 			{
-				output << "<item key=\"" << cur->pid << "\" m=\"" << cur->memory << "\" name=\"" << encodeForXml(string(cur->name)) << "\"></item>";
-				count++;
-				if(count == 20)
-					break;
+				const process_info *cur = &stats.memory[i];
+				output << "<item key=\"" << cur->pid << "\" m=\"" << cur->memory << "\" name=\"" << encodeForXml(cur->name) << "\"></item>";
 			}
 		}
 
@@ -660,5 +596,4 @@ string isr_process_data(int index, long sampleID, StatsProcesses stats, vector<s
 	}
 
 	
-	return output.str();
 }
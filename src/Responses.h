@@ -36,33 +36,107 @@
 #include <vector>
 #include <deque>
 #include <algorithm>
-#include <libxml/parser.h>
-#include <libxml/xmlmemory.h>
 
-#include "Stats.h"
+#include "StatsSnapshot.h"
 #include "System.h"
+#include "OutputBuffer.h"
+#include "Request.h"
 
-std::string isr_create_header();
+// Read-only view of the samples a client has not seen yet. Sample rings are
+// kept newest first with falling ids, so the view is a prefix of the ring
+// read back to front without copying. Polling clients usually want only the
+// newest few samples, so the search gallops from the front before narrowing
+// down with a binary search, O(log n) in the size of the view.
+template <class T>
+class SampleRange
+{
+	public:
+		SampleRange(const SampleRing<T> &_samples, double _after) : samples(_samples)
+		{
+			size_t low = 0, high = 1;
+			while (high <= samples.size() && samples[high - 1].sampleID > _after)
+			{
+				low = high;
+				high *= 2;
+			}
+			if (high > samples.size())
+				high = samples.size();
+
+			while (low < high)
+			{
+				size_t middle = low + (high - low) / 2;
+				if (samples[middle].sampleID > _after)
+					low = middle + 1;
+				else
+					high = middle;
+			}
+			count = low;
+		}
+
+		size_t size() const { return count; }
+
+		// Oldest first, the order samples are sent in
+		const T & operator [] (size_t i) const { return samples[count - 1 - i]; }
+
+	private:
+		const SampleRing<T> &samples;
+		size_t count;
+};
+
+// Items already written for one stat type, by key and tier. An item asked for
+// by several <x> elements, or two items sharing a key, are sent only once.
+// Keys are not copied, they have to outlive the AddedItems.
+class AddedItems
+{
+	public:
+		AddedItems() : used(0) {}
+
+		// Returns true the first time _key is added for tier _index
+		bool insert(int _index, const std::string &_key);
+
+	private:
+		struct Slot
+		{
+			Slot() : key(NULL), hash(0), tiers(0) {}
+
+			const std::string *key;
+			unsigned long long hash;
+			unsigned char tiers;
+		};
+
+		void grow();
+
+		// Open addressing, the size is a power of two
+		std::vector<Slot> slots;
+		size_t used;
+};
+
+const char * isr_create_header();
 std::string isr_accept_code();
 std::string isr_reject_code();
 std::string isr_accept_connection();
 std::string isr_serverinfo(int session, int auth, std::string uuid, bool historyEnabled);
+void isr_stats_data(OutputBuffer &output, const Request &request, const StatsSnapshot *snapshot, bool authenticated);
+void isr_request_fingerprint(OutputBuffer &key, const Request &request, const StatsSnapshot *snapshot, bool authenticated);
+std::string isr_stats_header(size_t length, bool compressed);
+
+EscapedXml encodeForXml(const std::string &text);
+EscapedXml encodeForXml(const char *text);
 
-bool shouldAddKey(int index, std::string key, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string keyForIndex(std::string uuid, int index);
+bool shouldAddKey(int index, const std::string &key, const RequestEntry &entry, AddedItems *added);
 
-std::string isr_multiple_data(xmlNodePtr node, Stats *stats);
-std::string isr_cpu_data(xmlNodePtr node, Stats *stats);
-std::string isr_network_data(int index, long sampleID, StatsNetwork stats, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string isr_disk_data(int index, long sampleID, StatsDisks stats, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string isr_uptime_data(long uptime);
-std::string isr_loadavg_data(xmlNodePtr node, Stats *stats);
-std::string isr_memory_data(xmlNodePtr node, Stats *stats);
+void isr_multiple_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot);
+void isr_cpu_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot);
+void isr_network_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<network_info> &stats, const RequestEntry &entry, AddedItems *added);
+void isr_disk_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<disk_info> &stats, const RequestEntry &entry, AddedItems *added);
+void isr_uptime_data(OutputBuffer &output, long uptime);
+void isr_loadavg_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot);
+void isr_memory_data(OutputBuffer &output, const RequestItem &item, const StatsSnapshot *snapshot);
 std::string isr_fan_data(std::vector<sensor_info> *_data, long _init);
 std::string isr_temp_data(std::vector<sensor_info> *_data, long _init);
-std::string isr_sensor_data(int index, long sampleID, StatsSensors stats, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string isr_activity_data(int index, long sampleID, StatsActivity stats, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string isr_battery_data(int index, long sampleID, StatsBattery stats, std::vector<std::string> keys, std::vector<std::string> *added);
-std::string isr_process_data(int index, long sampleID, StatsProcesses stats, std::vector<std::string> keys, std::vector<std::string> *added);
+void isr_sensor_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<sensor_info> &stats, const RequestEntry &entry, AddedItems *added);
+void isr_activity_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<activity_info> &stats, const RequestEntry &entry, AddedItems *added);
+void isr_battery_data(OutputBuffer &output, int index, long sampleID, const ItemsSnapshot<battery_info> &stats, const RequestEntry &entry, AddedItems *added);
+void isr_process_data(OutputBuffer &output, int index, long sampleID, const ProcessesSnapshot &stats, const RequestEntry &entry, AddedItems *added);
 
 #endif
@@ -0,0 +1,203 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <deque>
+#include <sstream>
+#include <iostream>
+#include <string.h>
+#include <pthread.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include "Utility.h"
+#include "SessionTickets.h"
+
+using namespace std;
+
+struct ticket_key
+{
+	unsigned char name[16];
+	unsigned char aes[32];
+	unsigned char hmac[32];
+	double created;
+};
+
+// Keys only ever live in memory, a restart makes every client do a full handshake
+static deque<ticket_key> ticketKeys;
+static pthread_mutex_t ticketLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long long fullHandshakes = 0;
+static unsigned long long resumedHandshakes = 0;
+
+static bool generate_ticket_key(double now)
+{
+	ticket_key key;
+
+	if (RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.aes, sizeof(key.aes)) != 1 || RAND_bytes(key.hmac, sizeof(key.hmac)) != 1)
+		return false;
+
+	key.created = now;
+	ticketKeys.push_front(key);
+
+	while (ticketKeys.size() > TICKET_KEY_HISTORY + 1)
+		ticketKeys.pop_back();
+
+	return true;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int set_ticket_mac(EVP_MAC_CTX *mac, unsigned char *key)
+{
+	OSSL_PARAM params[3];
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key, 32);
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+	return EVP_MAC_CTX_set_params(mac, params);
+}
+
+static int ticket_key_callback(SSL *, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cipher, EVP_MAC_CTX *mac, int enc)
+#else
+static int set_ticket_mac(HMAC_CTX *mac, unsigned char *key)
+{
+	return HMAC_Init_ex(mac, key, 32, EVP_sha256(), NULL);
+}
+
+static int ticket_key_callback(SSL *, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cipher, HMAC_CTX *mac, int enc)
+#endif
+{
+	ticket_key key;
+	int result = 1;
+
+	pthread_mutex_lock(&ticketLock);
+
+	if (enc)
+	{
+		double now = get_current_time();
+		if ((ticketKeys.empty() || ticketKeys.front().created + TICKET_KEY_LIFETIME < now) && !generate_ticket_key(now))
+		{
+			pthread_mutex_unlock(&ticketLock);
+			return -1;
+		}
+		key = ticketKeys.front();
+	}
+	else
+	{
+		result = 0;
+		for (size_t i = 0; i < ticketKeys.size(); i++)
+		{
+			if (memcmp(ticketKeys[i].name, key_name, sizeof(key.name)) == 0)
+			{
+				key = ticketKeys[i];
+
+				// Tickets from a retired key are accepted, but replaced with a fresh one
+				result = (i == 0) ? 1 : 2;
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&ticketLock);
+
+	// Unknown key, fall back to a full handshake
+	if (result == 0)
+		return 0;
+
+	if (enc)
+	{
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+			return -1;
+
+		memcpy(key_name, key.name, sizeof(key.name));
+
+		if (EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aes, iv) != 1)
+			return -1;
+	}
+	else
+	{
+		if (EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aes, iv) != 1)
+			return -1;
+	}
+
+	if (set_ticket_mac(mac, key.hmac) != 1)
+		return -1;
+
+	return result;
+}
+
+void InitSessionCache(SSL_CTX *ctx)
+{
+	static const unsigned char context[] = "istatserver";
+
+	// Stateful cache for clients that do not support tickets
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_session_id_context(ctx, context, sizeof(context) - 1);
+	SSL_CTX_sess_set_cache_size(ctx, 1024);
+	SSL_CTX_set_timeout(ctx, TICKET_KEY_LIFETIME * (TICKET_KEY_HISTORY + 1));
+
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	// Backgrounded clients often drop the connection without a close_notify,
+	// which would otherwise evict their session from the cache
+	SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_callback);
+#else
+	SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_callback);
+#endif
+}
+
+void CountHandshake(SSL *ssl)
+{
+	pthread_mutex_lock(&ticketLock);
+	if (SSL_session_reused(ssl))
+		resumedHandshakes++;
+	else
+		fullHandshakes++;
+	pthread_mutex_unlock(&ticketLock);
+}
+
+string SessionReport()
+{
+	stringstream report;
+
+	pthread_mutex_lock(&ticketLock);
+	report << "TLS handshakes: " << fullHandshakes << " full, " << resumedHandshakes << " resumed";
+	pthread_mutex_unlock(&ticketLock);
+
+	return report.str();
+}
@@ -44,6 +44,7 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <pthread.h>
 
 #ifdef HAVE_NETINET_IN_H
@@ -57,59 +58,15 @@
 #include <libxml/parser.h>
 #include <libxml/xmlmemory.h>
 
-#ifdef HAVE_LIBZLIB
-#include <zlib.h>
-#endif
-
 #include "Utility.h"
 #include "Socket.h"
+#include "SessionTickets.h"
 
 using namespace std;
 
 
-#ifdef HAVE_LIBZLIB
-std::string compress_string(const std::string& str, int compressionlevel = Z_BEST_COMPRESSION)
-{
-    z_stream zs;                        // z_stream is zlib's control structure
-    memset(&zs, 0, sizeof(zs));
-
-    if (deflateInit(&zs, compressionlevel) != Z_OK)
-    {
-    	return "";
-    }
-
-    zs.next_in = (Bytef*)str.data();
-    zs.avail_in = str.size();           // set the z_stream's input
-
-    int ret;
-    char outbuffer[32768];
-    std::string outstring;
-
-    // retrieve the compressed bytes blockwise
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-
-        ret = deflate(&zs, Z_FINISH);
-
-        if (outstring.size() < zs.total_out) {
-            // append the block to the output string
-            outstring.append(outbuffer,
-                             zs.total_out - outstring.size());
-        }
-    } while (ret == Z_OK);
-
-    deflateEnd(&zs);
-
-    if (ret != Z_STREAM_END) {          // an error occurred that was not EOF
-    	return "";
-    }
-
-    return outstring;
-}
-#endif
-
-int Socket::listen()
+// A shared listener lets several sockets bind the same port, the kernel spreads new connections across them
+int Socket::listen(int _backlog, bool _shared)
 {
 	int yes = 1;
 	hostent * host = NULL;
@@ -121,6 +78,23 @@ int Socket::listen()
 	}
 	
 	setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, (const char *) &yes, sizeof(yes));
+
+	if (_shared)
+	{
+#ifdef SO_REUSEPORT
+		if (setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (const char *) &yes, sizeof(yes)) == -1)
+		{
+			cout << "Could not share socket: " << strerror(errno) << endl;
+			return 0;
+		}
+#else
+		cout << "Could not share socket: SO_REUSEPORT is not supported" << endl;
+		return 0;
+#endif
+	}
+
+	// The socket set is edge triggered, so accept() is called until it would block
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
 	
 	struct timeval timeout;      
     timeout.tv_sec = 10;
@@ -154,7 +128,7 @@ int Socket::listen()
 	
 	// cout << "(" << address << ":" << port << ") Socket binded." << endl;
 	
-	if (::listen(socket, 5) == -1)
+	if (::listen(socket, _backlog) == -1)
 	{
 		cout << "Could not listen on socket: " << strerror(errno) << endl;
 		return 0;
@@ -165,7 +139,8 @@ int Socket::listen()
 }
 
 
-Socket Socket::accept()
+// Returns a new connection owned by the caller, NULL when there is none waiting
+Socket * Socket::accept()
 {
 	int theirSocket;
 	sockaddr_in theirAddress;
@@ -173,21 +148,35 @@ Socket Socket::accept()
 	
 	if ((theirSocket = ::accept(socket, (sockaddr *) &theirAddress, &size)) == -1)
 	{
-		cout << "Could not accept connection: " << strerror(errno) << endl;
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			cout << "Could not accept connection: " << strerror(errno) << endl;
+
+		return NULL;
 	}
 		
-	Socket socket(theirSocket, inet_ntoa(theirAddress.sin_addr), ntohs(theirAddress.sin_port));
-	socket.lastRequest = get_current_time();
-	socket.debugLogging = false;
-	socket.readbuf = "";
-	socket._session = _session;
-	socket._serverUUID = _serverUUID;
-	socket._sslEnabled = _sslEnabled;
-	socket.sslContext = sslContext;
-
-	cout << socket.get_description() << " New connection accepted. " << endl;
-
-    fcntl(socket.get_id(), F_SETFL, fcntl(socket.get_id(), F_GETFL, 0) | O_NONBLOCK);
+	Socket *socket = new Socket(theirSocket, inet_ntoa(theirAddress.sin_addr), ntohs(theirAddress.sin_port));
+	socket->isServer = false;
+	socket->lastRequest = get_monotonic_time();
+	socket->debugLogging = false;
+	socket->readbuf = "";
+	socket->readStart = 0;
+	socket->readScan = 0;
+	socket->_session = _session;
+	socket->_serverUUID = _serverUUID;
+	socket->_sslEnabled = _sslEnabled;
+	socket->sslContext = sslContext;
+	socket->workers = workers;
+	socket->serial = ++acceptedCount;
+	socket->busy = false;
+	socket->outputChunk = 0;
+	socket->outputOffset = 0;
+	socket->outputSize = 0;
+	socket->writeProgress = 0;
+	socket->timerDeadline = 0;
+
+	cout << socket->get_description() << " New connection accepted. " << endl;
+
+    fcntl(socket->get_id(), F_SETFL, fcntl(socket->get_id(), F_GETFL, 0) | O_NONBLOCK);
 
 /*    struct timeval timeout;      
     timeout.tv_sec = 10;
@@ -213,347 +202,415 @@ string Socket::get_description()
 	return desc.str();
 }
 
-int Socket::send(string data)
+int Socket::send(string _data)
 {
-//	cout << "Writing- " << data << endl;
-	int r = 0;
-	
-	if(secure == true)
+	queue(_data);
+	return flush();
+}
+
+// Takes the contents of _data without copying, it is left empty
+void Socket::queue(string & _data)
+{
+	if(_data.empty())
+		return;
+
+	ResponseData data;
+	data.chunks().push_back(string());
+	data.chunks().back().swap(_data);
+	queue(data);
+}
+
+// Shares the chunks of _data, which must not change until they are written
+void Socket::queue(const ResponseData & _data)
+{
+	if(_data.count() == 0)
+		return;
+
+	// A stalled writer is measured from when output first starts waiting
+	if(output.empty())
+		writeProgress = get_monotonic_time();
+
+	output.push_back(_data);
+	outputSize += _data.size();
+}
+
+// Writes queued data until the socket would block. Returns 0 when the connection should be dropped.
+int Socket::flush()
+{
+	while(!output.empty())
 	{
-		while(data.size() > 0)
+		const string &chunk = output.front()[outputChunk];
+		if(outputOffset == chunk.size())
+		{
+			outputOffset = 0;
+			if(++outputChunk == output.front().count())
+			{
+				output.pop_front();
+				outputChunk = 0;
+			}
+			continue;
+		}
+
+		size_t length = chunk.size() - outputOffset;
+		if(length > 16384)
+			length = 16384;
+
+		const char *start = chunk.data() + outputOffset;
+		int r;
+
+		if(debugLogging)
+			cout << get_description() << " Writing " << length << " bytes" << endl;
+
+		if(secure == true)
 		{
 			ERR_clear_error();
+			r = SSL_write(ssl, start, length);
 
-			unsigned int limit = 8192;
+			if(debugLogging)
+				cout << get_description() << " Write result " << r << ", ssl error " << SSL_get_error (ssl,r) << ", errorno " << errno << ", err_get_error " << ERR_get_error() << endl;
 
-			if(data.size() > limit)
+			if(r <= 0)
 			{
-				if(debugLogging)
-					cout << get_description() << " Writing " << limit << " bytes" << endl;
-				r = SSL_write(ssl, data.substr(0, limit).c_str(), limit);
+				switch ( SSL_get_error (ssl,r) ){
+					case SSL_ERROR_WANT_READ:
+					case SSL_ERROR_WANT_WRITE:
+						// The socket set reports when there is room again
+						return 1;
+					case SSL_ERROR_ZERO_RETURN:
+						cout << get_description() << " SSL connection closed by peer" << endl;
+						return 0;
+					default:
+						cout << get_description() << " SSL write error - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
+						return 0;
+				}
 			}
-			else
+		}
+		else
+		{
+			if ((r = ::send(socket, start, length, 0)) == -1)
 			{
-				if(debugLogging)
-					cout << get_description() << " Writing " << data.size() << " bytes" << endl;
-				r = SSL_write(ssl, data.c_str(), data.size());
-			}
-
-			if(debugLogging)
-				cout << get_description() << " Write result " << r << ", ssl error " << SSL_get_error (ssl,r) << ", errorno " << errno << ", err_get_error " << ERR_get_error() << endl;
+				if(errno == EAGAIN || errno == EWOULDBLOCK)
+					return 1;
 
-			switch ( SSL_get_error (ssl,r) ){
-				case SSL_ERROR_NONE:
-					data = data.substr(r, readbuf.size() - r);
-					break;
-				case SSL_ERROR_WANT_READ:
-				case SSL_ERROR_WANT_WRITE:
-					break;
-				case SSL_ERROR_ZERO_RETURN:
-					cout << get_description() << " SSL connection closed by peer" << endl;
-					return 0;
-				break;
-				default:
-	//					cout << get_description() << " SSL error - " << ERR_error_string( SSL_get_error(ssl, r), NULL ) << endl;
-					cout << get_description() << " SSL write error - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
-					return 0;
-				break;
+				cout << get_description() << " Could not send data: " << strerror(errno) << endl;
+				return 0;
 			}
 		}
+
+		outputOffset += r;
+		outputSize -= r;
+		writeProgress = get_monotonic_time();
 	}
-	else
+
+	return 1;
+}
+
+bool Socket::pending_output()
+{
+	return !output.empty();
+}
+
+// Monotonic time at which the connection should be dropped if nothing else happens
+double Socket::get_deadline()
+{
+	if(state == SocketStateHandshaking)
+		return handshakeDeadline;
+
+	double deadline = lastRequest + SOCKET_IDLE_TIMEOUT;
+	if(pending_output() && writeProgress + SOCKET_WRITE_TIMEOUT < deadline)
+		deadline = writeProgress + SOCKET_WRITE_TIMEOUT;
+
+	return deadline;
+}
+
+// Requests are answered in order, so nothing is read while a worker builds the previous
+// response or while the client is not reading its responses. Its input stays with the
+// kernel and TCP flow control holds the client back.
+bool Socket::wants_input()
+{
+	return !busy && outputSize <= SOCKET_OUTPUT_HIGH_WATER;
+}
+
+// Reads one chunk into readbuf. Returns the bytes read, 0 once nothing is waiting
+// and -1 when the connection is closed or failed.
+int Socket::fill()
+{
+	if(secure == true)
 	{
-		if ((r = ::send(socket, data.c_str(), data.size(), 0)) == -1)
-		{
-			cout << get_description() << " Could not send data: " << strerror(errno) << endl;
-			return 0;
-		}		
+		// Decrypted data already buffered by openssl is taken in one read
+		size_t chunk = SSL_pending(ssl);
+		if(chunk < SOCKET_READ_CHUNK)
+			chunk = SOCKET_READ_CHUNK;
+
+		size_t filled = readbuf.size();
+		readbuf.resize(filled + chunk);
+
+		ERR_clear_error();
+		int r = SSL_read (ssl, &readbuf[filled], chunk);
+		readbuf.resize(filled + (r > 0 ? r : 0));
+
+		if(debugLogging)
+			cout << get_description() << " Read result " << r << ", ssl error " << SSL_get_error (ssl,r) << ", errorno " << errno << ", err_get_error " << ERR_get_error() << endl;
+
+		switch ( SSL_get_error (ssl,r) ){
+			case SSL_ERROR_NONE:
+				return r;
+			case SSL_ERROR_WANT_READ:
+			case SSL_ERROR_WANT_WRITE:
+				return 0;
+			case SSL_ERROR_ZERO_RETURN:
+				cout << get_description() << " SSL connection closed by peer" << endl;
+				return -1;
+			default:
+//				cout << get_description() << " SSL read error - " << ERR_error_string( SSL_get_error(ssl, r), NULL ) << endl;
+				cout << get_description() << " SSL read error - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
+				return -1;
+		}
 	}
-	
-	// cout << "(" << address << ":" << port << ") Data sent: " << _data << endl;
-	
-	return r;
-}
 
+	// Size the read by what the kernel has queued
+	int available = 0;
+	size_t chunk = SOCKET_READ_CHUNK;
+	if(ioctl(socket, FIONREAD, &available) == 0 && (size_t)available > chunk)
+		chunk = available;
+	if(chunk > SOCKET_INPUT_LIMIT)
+		chunk = SOCKET_INPUT_LIMIT;
+
+	size_t filled = readbuf.size();
+	readbuf.resize(filled + chunk);
+
+	#ifdef MSG_DONTWAIT
+	int ret = recv(socket, &readbuf[filled], chunk, MSG_DONTWAIT);
+	#else
+	int ret = recv(socket, &readbuf[filled], chunk, MSG_NONBLOCK);
+	#endif
+	readbuf.resize(filled + (ret > 0 ? ret : 0));
+
+	if(ret < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
+		return 0;
+	if(ret <= 0)
+		return -1;
+	return ret;
+}
 
 int Socket::receive(ClientSet * _clients, Config * _config, Stats * _stats)
 {
-	char buf[1024];
-    int len = 0;
+	int len = 0;
 
-	if(secure == true)
+	if(state == SocketStateHandshaking)
 	{
-		do {
-			memset(buf, 0, 1024);
-			ERR_clear_error();
-			int r = SSL_read (ssl, buf, 1024);
+		int result = continueSSL();
+		if(result < 0)
+			return 0;
+		if(result == 0)
+			return 1;
 
-			if(debugLogging)
-				cout << get_description() << " Read result " << r << ", ssl error " << SSL_get_error (ssl,r) << ", errorno " << errno << ", err_get_error " << ERR_get_error() << endl;
-
-			switch ( SSL_get_error (ssl,r) ){
-				case SSL_ERROR_NONE:
-					len += r;
-					readbuf += buf;
-//					if(debugLogging)
-//						cout << "Read bytes " << buf << endl;
-
-				break;
-				case SSL_ERROR_WANT_READ:
-				case SSL_ERROR_WANT_WRITE:
-					break;
-				case SSL_ERROR_ZERO_RETURN:
-					cout << get_description() << " SSL connection closed by peer" << endl;
-					return 0;
-				break;
-				default:
-//					cout << get_description() << " SSL read error - " << ERR_error_string( SSL_get_error(ssl, r), NULL ) << endl;
-					cout << get_description() << " SSL read error - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
-					return 0;
-				break;
-			}
-		}
-		while(SSL_pending (ssl) > 0);
+		// The client may have sent its first request along with the end of the handshake
 	}
-	else
+
+	// Keep reading until the socket runs dry, the socket set only reports new data once.
+	// Requests are answered as they arrive, so at most one chunk waits in readbuf.
+	while(wants_input())
 	{
-		while(1)
+		int read = fill();
+		if(read < 0)
+			return 0;
+		if(read == 0)
+			break;
+		len += read;
+
+		process(_clients, _config, _stats);
+
+		if(readbuf.size() - readStart > SOCKET_INPUT_LIMIT)
 		{
-			memset(buf, 0, 1024);
-			#ifdef MSG_DONTWAIT
-			int ret = recv(socket, buf, 1024, MSG_DONTWAIT);
-			#else
-			int ret = recv(socket, buf, 1024, MSG_NONBLOCK);
-			#endif
-			if(ret < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
-			{
-				break;
-			}
-			else if(ret <= 0)
-			{
-				return 0;
-			}
-			else
-			{
-				len += ret;
-				readbuf += buf;
-			}
+			cout << get_description() << " Removing connection, request too large" << endl;
+			return 0;
 		}
 	}
 
-	size_t position = readbuf.find("</isr>");
-	if(position != std::string::npos)
+	// Nothing to read is not an error, the peer closing the connection is handled above
+	return len > 0 ? len : 1;
+}
+
+// Answers every complete request in the read buffer. Requests are framed by
+// their closing tag, the search picks up where the previous one stopped.
+void Socket::process(ClientSet * _clients, Config * _config, Stats * _stats)
+{
+	static const char terminator[] = "</isr>";
+	static const size_t terminatorLength = sizeof(terminator) - 1;
+
+	// Requests are answered in order, so wait while a worker builds the previous response.
+	// A client that is not reading its responses gets no new ones until the queue drains.
+	while(wants_input())
 	{
-		lastRequest = get_current_time();
-		string xml = readbuf.substr(0, position);
+		size_t position = readbuf.find(terminator, readScan);
+		if(position == std::string::npos)
+		{
+			// Only the tail could still hold the start of a terminator
+			if(readbuf.size() > readStart + terminatorLength)
+				readScan = readbuf.size() - terminatorLength;
+			break;
+		}
+
+		lastRequest = get_monotonic_time();
+		position += terminatorLength;
+
+		size_t start = readStart;
+		readStart = position;
+		readScan = position;
 //		if(debugLogging)
-//			cout << get_description() << " Read xml data " << xml << endl;
-		parse(readbuf, _clients, _config, _stats);
-		position += 6;
-		readbuf = readbuf.substr(position, readbuf.size() - position);
+//			cout << get_description() << " Read xml data " << readbuf.substr(start, position - start) << endl;
+		parse(readbuf.data() + start, position - start, _clients, _config, _stats);
 	}
 
-	return len;
+	// Drop consumed requests once they make up most of the buffer, so it is not shifted after every one
+	if(readStart == readbuf.size())
+	{
+		readbuf.clear();
+		readStart = 0;
+		readScan = 0;
+	}
+	else if(readStart > readbuf.size() / 2)
+	{
+		readbuf.erase(0, readStart);
+		readScan -= readStart;
+		readStart = 0;
+	}
+}
+
+int Socket::complete(ResponseJob * _job, ClientSet * _clients, Config * _config, Stats * _stats)
+{
+	busy = false;
+
+	// Take the parsed request back so its buffers are reused for the next one
+	request.swap(_job->request);
+
+	queue(_job->header);
+	queue(_job->data);
+	if(!flush())
+		return 0;
+
+	// Input left waiting while the response was built raises no new event
+	process(_clients, _config, _stats);
+	return receive(_clients, _config, _stats) > 0 ? 1 : 0;
 }
 
 void Socket::close()
 {
+	if(ssl != NULL)
+	{
+		// Sessions that were not shut down are dropped from the session cache
+		if(state == SocketStateEstablished)
+			SSL_shutdown(ssl);
+
+		SSL_free(ssl);
+		ssl = NULL;
+	}
+
+	if(socket >= 0 && fcntl(socket, F_GETFD) != -1)
+		::close(socket);
 }
 
 int Socket::startSSL()
 {
 	ssl = SSL_new(sslContext);
+	if(ssl == NULL)
+	{
+		ERR_print_errors_fp(stdout);
+		fflush(stdout);
+		return -1;
+	}
+
 	SSL_set_fd(ssl, socket);
 	SSL_set_accept_state(ssl);
+
+	state = SocketStateHandshaking;
+	handshakeDeadline = get_monotonic_time() + SSL_HANDSHAKE_TIMEOUT;
+
+	return continueSSL() < 0 ? -1 : 0;
+}
+
+// Advances the handshake as far as the socket allows without blocking.
+// Returns 1 once established, 0 while waiting for the client and -1 on failure.
+int Socket::continueSSL()
+{
+	ERR_clear_error();
 	int code = SSL_accept(ssl);
 
-	if ( code != 1){
-		int error = SSL_get_error(ssl, code);
-	    while (code != 1 && (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE))
-	    {
-	    	code = SSL_accept(ssl);
-			error = SSL_get_error(ssl, code);
-		}
-		if(code != 1)
-		{
-			cout << get_description() << " Error starting SSL: " << ERR_error_string( SSL_get_error(ssl, code), NULL ) <<endl;
-			cout << get_description() << " Error starting SSL - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
-			ERR_print_errors_fp(stdout);
-			fflush(stdout);
-			return -1;
-		}
-    }
+	if(code == 1)
+	{
+		state = SocketStateEstablished;
+		secure = true;
+		CountHandshake(ssl);
+		return 1;
+	}
+
+	int error = SSL_get_error(ssl, code);
+	if(error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+		return 0;
 
-	secure = true;
-	return 0;
+	cout << get_description() << " Error starting SSL: " << ERR_error_string( error, NULL ) <<endl;
+	cout << get_description() << " Error starting SSL - " << ERR_error_string( ERR_get_error(), NULL ) << endl;
+	ERR_print_errors_fp(stdout);
+	fflush(stdout);
+	return -1;
 }
 
-void Socket::parse(string _data, ClientSet * _clients, Config * _config, Stats * _stats)
+void Socket::parse(const char * _data, size_t _length, ClientSet * _clients, Config * _config, Stats * _stats)
 {
-	stringstream temp;
-	string content, element_name;
-		
 	// Load properties from config file
 	string cf_server_code = _config->get("server_code", "00000");
 	string cf_server_reject_delay = _config->get("server_reject_delay", "3");
 
-	
-	xmlDocPtr doc;
-	xmlNodePtr cur;
-	xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
-	
-	doc = xmlCtxtReadMemory(ctxt, _data.c_str(), _data.length(), NULL, NULL, 0);
-	
-	if ((cur = xmlDocGetRootElement(doc)) != NULL)
-	{
-		if (xmlStrEqual(cur->name, BAD_CAST "isr"))
-		{
-	   		char *type = (char *)xmlGetProp(cur, (const xmlChar *)"type");
-			int code = atoi(type);
-			free(type);
-			
-			if(code == 100){
-	   			char *protocol = (char *)xmlGetProp(cur, (const xmlChar *)"protocol");
-				_protocol = atoi(protocol);
-
-				send(isr_accept_connection());
-				free(protocol);
-			}
-			if(code == 101){
-	   			char *uuid = (char *)xmlGetProp(cur, (const xmlChar *)"uuid");
-	   			char *name = (char *)xmlGetProp(cur, (const xmlChar *)"name");
-	   			char *version = (char *)xmlGetProp(cur, (const xmlChar *)"version");
-
-				_uuid = string(uuid);
-				_name = string(name);
-
-				int auth = 1;
-				if (_clients->is_authenticated(_uuid))
-					auth = 0;
-				else {
-					int code = atoi(cf_server_code.c_str());
-					std::ostringstream stm;
-					stm << code;
-					string stringcode = stm.str();
-
-					// check if code is a 5 digit number
-					if(cf_server_code != stringcode || cf_server_code.length() != 5){
-						auth = 2; // text based passcode
-					}
-				}
+	if (!request.parse(_data, _length))
+		return;
 
-				send(isr_serverinfo(_session, auth, _serverUUID, _stats->historyEnabled));
+	int code = request.type;
 
-				free(uuid);
-				free(name);
-				free(version);
-			}
+	if(code == 100){
+		_protocol = atoi(request.protocol.c_str());
 
-			if(code == 102){
-	   			char *code = (char *)xmlGetProp(cur, (const xmlChar *)"code");
-				if (code == cf_server_code)
-				{
-					_clients->authenticate(_uuid);
-					send(isr_accept_code());
-				}
-				else {
-					send(isr_reject_code());
-				}
-				free(code);
+		send(isr_accept_connection());
+	}
+	if(code == 101){
+		_uuid = request.uuid;
+		_name = request.name;
+
+		int auth = 1;
+		if (_clients->is_authenticated(_uuid))
+			auth = 0;
+		else {
+			int code = atoi(cf_server_code.c_str());
+			std::ostringstream stm;
+			stm << code;
+			string stringcode = stm.str();
+
+			// check if code is a 5 digit number
+			if(cf_server_code != stringcode || cf_server_code.length() != 5){
+				auth = 2; // text based passcode
 			}
+		}
 
-			if(code == 103){
-				pthread_mutex_lock(&_stats->lock);	
-				temp << isr_create_header() << "<isr type=\"104\">";
-				if (_clients->is_authenticated(_uuid))
-				{
-					xmlNodePtr child = cur->children;
-					while (child){
-						char *type = (char *)xmlGetProp(child, (const xmlChar *)"type");
-						if(type == NULL)
-						{
-							child = child->next;
-							continue;
-						}
-						if(strcmp(type, "cpu") == 0)
-						{
-							temp << isr_cpu_data(child, _stats);
-						}
-						if(strcmp(type, "memory") == 0)
-						{
-							temp << isr_memory_data(child, _stats);
-						}
-						if(strcmp(type, "load") == 0)
-						{
-							temp << isr_loadavg_data(child, _stats);
-						}
-						if(strcmp(type, "network") == 0)
-						{
-							#ifndef USE_NET_NONE
-							temp << isr_multiple_data(child, _stats);
-							#endif
-						}
-						if(strcmp(type, "diskactivity") == 0)
-						{
-							#ifndef USE_ACTIVITY_NONE
-							temp << isr_multiple_data(child, _stats);
-							#endif
-						}
-						if(strcmp(type, "processes") == 0)
-						{
-							#ifndef USE_PROCESSES_NONE
-							temp << isr_multiple_data(child, _stats);
-							#endif
-						}
-						if(strcmp(type, "disks") == 0)
-						{
-							#ifndef USE_DISK_NONE
-							temp << isr_multiple_data(child, _stats);
-							#endif
-						}
-						if(strcmp(type, "sensors") == 0)
-						{
-							temp << isr_multiple_data(child, _stats);
-						}
-						if(strcmp(type, "uptime") == 0)
-						{
-							temp << isr_uptime_data(_stats->uptime());
-						}
-						if(strcmp(type, "battery") == 0)
-						{
-							#ifndef USE_BATTERY_NONE
-							temp << isr_multiple_data(child, _stats);
-							#endif
-						}						
-
-						free(type);
-						child = child->next;
-					}
-				}
-				pthread_mutex_unlock(&_stats->lock);
-
-				temp << "</isr>";
-
-				string data = temp.str();
-				string compressedTag = "";
-			
-				#ifdef HAVE_LIBZLIB
-				string compressedData = compress_string(data, Z_BEST_COMPRESSION);
-				if(compressedData.size() > 0)
-				{
-					compressedTag = " c=\"1\"";
-					data = compressedData;
-				}
-				#endif
+		send(isr_serverinfo(_session, auth, _serverUUID, _stats->historyEnabled));
+	}
 
-				stringstream temp2;
-				temp2 << "<?xml version=\"1.0\" encoding=\"UTF-8\"?><isr type=\"105\" length=\"" << data.length() << "\"" << compressedTag << "></isr>";
-				send(temp2.str());
-				send(data);
-			}
-		} // Unknown element recived after header
-	} // Failed to read header
+	if(code == 102){
+		if (request.code == cf_server_code)
+		{
+			_clients->authenticate(_uuid);
+			send(isr_accept_code());
+		}
+		else {
+			send(isr_reject_code());
+		}
+	}
 
-	xmlFreeDoc(doc);
-	xmlFreeParserCtxt(ctxt);
+	if(code == 103){
+		// Serialization and compression happen on a worker, the request goes with the job
+		ResponseJob *job = new ResponseJob(socket, serial, _clients->is_authenticated(_uuid));
+		job->request.swap(request);
+
+		busy = true;
+		workers->submit(job);
+	}
 }
@@ -37,36 +37,69 @@
 #include <stdlib.h>
 #include <iostream>
 #include <string>
+#include <deque>
 #include <sys/param.h>
 
 #include "Clientset.h"
 #include "Conf.h"
 #include "Stats.h"
 #include "Responses.h"
+#include "WorkerPool.h"
+#include "Request.h"
+#include "ResponseData.h"
 
 #include "Certificate.h"
 
+#define SocketStateHandshaking 0
+#define SocketStateEstablished 1
+
+// Seconds a client gets to complete the TLS handshake
+#define SSL_HANDSHAKE_TIMEOUT 10
+
+// Seconds a client may go without sending a request
+#define SOCKET_IDLE_TIMEOUT 120
+
+// Seconds queued output may sit without any of it being written
+#define SOCKET_WRITE_TIMEOUT 30
+
+// Smallest read taken from a connection, larger when more is known to be waiting
+#define SOCKET_READ_CHUNK 16384
+
+// Unanswered input above which the connection is dropped, requests are far smaller
+#define SOCKET_INPUT_LIMIT (64 * 1024)
+
+// Queued output bytes above which no further requests are answered
+#define SOCKET_OUTPUT_HIGH_WATER (256 * 1024)
+
 class Socket
 {
     public:
-        Socket(const std::string & _address, unsigned int _port) : listener(true), port(_port), address(_address) {}
-        Socket(int _socket, std::string _address, unsigned int _port) : secure(false), socket(_socket), listener(false), port(_port), address(_address) {}
+        Socket(const std::string & _address, unsigned int _port) : ssl(NULL), state(SocketStateEstablished), workers(NULL), acceptedCount(0), busy(false), readStart(0), readScan(0), outputChunk(0), outputOffset(0), outputSize(0), writeProgress(0), timerDeadline(0), listener(true), port(_port), address(_address) {}
+        Socket(int _socket, std::string _address, unsigned int _port) : ssl(NULL), secure(false), state(SocketStateHandshaking), workers(NULL), acceptedCount(0), busy(false), readStart(0), readScan(0), outputChunk(0), outputOffset(0), outputSize(0), writeProgress(0), timerDeadline(0), socket(_socket), listener(false), port(_port), address(_address) {}
         
         int get_id() { return socket; }
         bool get_listener() { return listener; }
         unsigned int get_port() { return port; }
         std::string get_address() { return address; }
         std::string get_description();
-        int send(std::string data);
+        int send(std::string _data);
+        void queue(std::string & _data);
+        void queue(const ResponseData & _data);
+        int flush();
+        bool pending_output();
+        bool wants_input();
+        double get_deadline();
         int receive(ClientSet * _clients, Config * _config, Stats * _stats);
-        Socket accept();
-        int listen();
+        int complete(ResponseJob * _job, ClientSet * _clients, Config * _config, Stats * _stats);
+        Socket * accept();
+        int listen(int _backlog = 5, bool _shared = false);
 
         void initClient(int s);
         void startReading();
         void close();        
 
         int startSSL();
+        int continueSSL();
         SSL *ssl;
         SSL_CTX *sslContext;
 
@@ -81,13 +114,39 @@ class Socket
         std::string readbuf;
         bool secure;
         bool debugLogging;
+        int state;
+        double handshakeDeadline;
+
+        WorkerPool *workers;
+        unsigned long long serial;
+        unsigned long long acceptedCount;
+        bool busy;
+
+        // Start of the first unanswered request in readbuf, and where the search for its end resumes
+        size_t readStart;
+        size_t readScan;
+
+        // Every request on the connection is parsed into this one
+        Request request;
+
+        // Responses waiting to be written, outputChunk and outputOffset are where in the first one
+        std::deque<ResponseData> output;
+        size_t outputChunk;
+        size_t outputOffset;
+        size_t outputSize;
+        double writeProgress;
+
+        // Deadline the socket set has a live timer for, 0 when there is none
+        double timerDeadline;
 
     private:
         int socket;
         bool listener;
         unsigned int port;
         std::string address;
-        void parse(std::string _data, ClientSet * _clients, Config * _config, Stats * _stats);
+        void parse(const char * _data, size_t _length, ClientSet * _clients, Config * _config, Stats * _stats);
+        int fill();
+        void process(ClientSet * _clients, Config * _config, Stats * _stats);
 };
 
 #endif
@@ -31,6 +31,7 @@
 
 #include <vector>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <iostream>
 
@@ -47,114 +48,287 @@ using namespace std;
 
 SocketSet::SocketSet()
 {
+#ifdef HAVE_SYS_EPOLL_H
+	poller = epoll_create1(EPOLL_CLOEXEC);
+	if (poller == -1)
+		cout << "Could not create epoll instance: " << strerror(errno) << endl;
+
+	events.resize(64);
+#else
 	highest = 0;
 	
 	FD_ZERO(&socketset);
+#endif
 }
 
-void SocketSet::operator += (Socket & _socket)
+SocketSet::~SocketSet()
+{
+	for (vector<Socket *>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
+	{
+		delete *socket;
+	}
+}
+
+// Takes ownership of _socket, it is closed and freed if it cannot be watched
+void SocketSet::operator += (Socket * _socket)
 {
-	if (_socket.get_id() > highest)
-		highest = _socket.get_id();
+	int fd = _socket->get_id();
+	if (fd < 0)
+	{
+		delete _socket;
+		return;
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	// Edge triggered, so readers must drain the socket until EAGAIN. Write
+	// readiness lets a TLS handshake waiting to write carry on.
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.fd = fd;
+
+	if (epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		cout << _socket->get_description() << " Could not watch socket: " << strerror(errno) << endl;
+		_socket->close();
+		delete _socket;
+		return;
+	}
+#else
+	if (fd >= FD_SETSIZE)
+	{
+		cout << _socket->get_description() << " Too many open connections." << endl;
+		_socket->close();
+		delete _socket;
+		return;
+	}
+
+	if (fd > highest)
+		highest = fd;
 	
+	FD_SET(fd, &socketset);
+#endif
+
+	if ((size_t)fd >= positions.size())
+		positions.resize(fd + 1, -1);
+
+	positions[fd] = connections.size();
 	connections.push_back(_socket);
-	FD_SET(_socket.get_id(), &socketset);
+
+	if (!_socket->isServer)
+		schedule(*_socket);
+}
+
+// Watches a copy of _socket, used for sockets that live outside the set such as the listener
+void SocketSet::operator += (Socket & _socket)
+{
+	*this += new Socket(_socket);
+}
+
+// Reports readiness of a descriptor that is not a connection, such as a wakeup pipe
+void SocketSet::watch(int _fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLET;
+	event.data.fd = _fd;
+
+	if (epoll_ctl(poller, EPOLL_CTL_ADD, _fd, &event) == -1)
+		cout << "Could not watch descriptor: " << strerror(errno) << endl;
+#else
+	if (_fd > highest)
+		highest = _fd;
+
+	FD_SET(_fd, &socketset);
+	watched.push_back(_fd);
+#endif
 }
 
 void SocketSet::operator -= (Socket & _socket)
 {
 	cout << _socket.get_description() << " Disconnected." << endl;
 
-	FD_CLR(_socket.get_id(), &socketset);
+	int fd = _socket.get_id();
+
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_ctl(poller, EPOLL_CTL_DEL, fd, NULL);
+#else
+	FD_CLR(fd, &socketset);
+#endif
+
+	_socket.close();
+
+	if (fd < 0 || (size_t)fd >= positions.size() || positions[fd] == -1)
+		return;
 
-	if(fcntl(_socket.get_id(), F_GETFD) != -1)
-		::close(_socket.get_id());
+	// Move the last connection into the free slot instead of shifting the vector
+	int position = positions[fd];
+	positions[fd] = -1;
 
-	for (std::vector<Socket>::iterator eraser = connections.begin(); eraser != connections.end(); ++eraser)
+	Socket *removed = connections[position];
+	if ((size_t)position != connections.size() - 1)
 	{
-		if ((*eraser).get_id() == _socket.get_id())
-		{
-			connections.erase(eraser);
-			
-			break;
-		}
+		connections[position] = connections.back();
+		positions[connections[position]->get_id()] = position;
 	}
+	connections.pop_back();
 	
-	if (_socket.get_id() == highest)
+#ifndef HAVE_SYS_EPOLL_H
+	if (fd == highest)
 	{
 		highest = 0;
+
+		for (std::vector<int>::iterator higher = watched.begin(); higher != watched.end(); ++higher)
+		{
+			if (highest < *higher)
+				highest = *higher;
+		}
 		
-		for (std::vector<Socket>::iterator higher = connections.begin(); higher != connections.end(); ++higher)
+		for (std::vector<Socket *>::iterator higher = connections.begin(); higher != connections.end(); ++higher)
 		{
-			if (highest < (*higher).get_id())
+			if (highest < (*higher)->get_id())
 			{
-				highest = (*higher).get_id();
+				highest = (*higher)->get_id();
 			}
 		}
 	}
-}
+#endif
 
-bool SocketSet::operator == (Socket & _socket)
-{
-	return FD_ISSET(_socket.get_id(), &readyset);
+	delete removed;
 }
 
-Socket & SocketSet::get_ready()
+Socket * SocketSet::get_socket(int _socket)
 {
-	for (vector<Socket>::iterator ready = connections.begin(); ready != connections.end(); ++ready)
-	{
-			if (FD_ISSET((*ready).get_id(), &readyset))
-			{
-					return *ready;
-			}
-	}
-	
-	return connections.front();
-}
+	if (_socket < 0 || (size_t)_socket >= positions.size() || positions[_socket] == -1)
+		return NULL;
 
-Socket & SocketSet::get_socket(int _socket)
-{
-	for (vector<Socket>::iterator ready = connections.begin(); ready != connections.end(); ++ready)
-	{
-			if ((*ready).get_id() == _socket)
-			{
-					return *ready;
-			}
-	}
-	
-	return connections.front();
+	return connections[positions[_socket]];
 }
 
 int SocketSet::get_status(int _timeout)
 {
 	int result;
+
+	ready.clear();
+
+#ifdef HAVE_SYS_EPOLL_H
+	result = epoll_wait(poller, &events[0], events.size(), _timeout > 0 ? _timeout * 1000 : -1);
+
+	if (result <= 0)
+		return result;
+
+	for (int i = 0; i < result; i++)
+		ready.push_back(events[i].data.fd);
+
+	// A full batch means there may be more waiting, make room for next time
+	if ((size_t)result == events.size())
+		events.resize(events.size() * 2);
+#else
 	timeval timeout;
 	
 	timeout.tv_sec = _timeout;
 	timeout.tv_usec = 0;
 	
 	readyset = socketset;
+
+	// Only wait for room to write on connections with queued output, and for
+	// input on connections that will read it
+	FD_ZERO(&writeset);
+	for (vector<Socket *>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
+	{
+		if ((*socket)->pending_output())
+			FD_SET((*socket)->get_id(), &writeset);
+		if (!(*socket)->wants_input())
+			FD_CLR((*socket)->get_id(), &readyset);
+	}
 	
 	if (_timeout > 0)
-		result = select(highest + 1, &readyset, NULL, NULL, &timeout);
+		result = select(highest + 1, &readyset, &writeset, NULL, &timeout);
 	else
-		result = select(highest + 1, &readyset, NULL, NULL, NULL);
+		result = select(highest + 1, &readyset, &writeset, NULL, NULL);
+
+	if (result <= 0)
+		return result;
+
+	for (vector<int>::iterator fd = watched.begin(); fd != watched.end(); ++fd)
+	{
+		if (FD_ISSET(*fd, &readyset))
+			ready.push_back(*fd);
+	}
+
+	for (vector<Socket *>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
+	{
+		if (FD_ISSET((*socket)->get_id(), &readyset) || FD_ISSET((*socket)->get_id(), &writeset))
+			ready.push_back((*socket)->get_id());
+	}
+#endif
 	
-	return result;
+	return ready.size();
+}
+
+// Only deadlines that moved earlier need a new timer, later ones are picked up when the old timer fires
+void SocketSet::schedule(Socket & _socket)
+{
+	double deadline = _socket.get_deadline();
+
+	if (_socket.timerDeadline == 0 || deadline < _socket.timerDeadline)
+	{
+		_socket.timerDeadline = deadline;
+		timers.schedule(_socket.get_id(), _socket.serial, deadline);
+	}
+}
+
+// Drops connections whose deadline has passed, only timers that are due are looked at
+void SocketSet::expire(double _now)
+{
+	vector<TimerEntry> due;
+	timers.expired(_now, due);
+
+	for (vector<TimerEntry>::iterator entry = due.begin(); entry != due.end(); ++entry)
+	{
+		Socket *socket = get_socket((*entry).fd);
+
+		// Timers of closed connections, or ones superseded by an earlier deadline, are left to lapse
+		if (socket == NULL || socket->serial != (*entry).serial || socket->timerDeadline != (*entry).deadline)
+			continue;
+
+		double deadline = socket->get_deadline();
+		if (deadline > _now)
+		{
+			socket->timerDeadline = deadline;
+			timers.schedule(socket->get_id(), socket->serial, deadline);
+			continue;
+		}
+
+		if (socket->state == SocketStateHandshaking)
+			cout << socket->get_description() << " Removing connection due to handshake timeout." << endl;
+		else if (socket->pending_output() && socket->writeProgress + SOCKET_WRITE_TIMEOUT <= _now)
+			cout << socket->get_description() << " Removing connection due to write timeout." << endl;
+		else
+			cout << socket->get_description() << " Removing connection due to timeout: " << (long long)(_now - socket->lastRequest) << endl;
+
+		*this -= *socket;
+	}
 }
 
 void SocketSet::send(const string & _data)
 {
-	for (vector<Socket>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
+	for (vector<Socket *>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
 	{
-		if (!(*socket).get_listener()) (*socket).send(_data);
+		if (!(*socket)->get_listener()) (*socket)->send(_data);
 	}
 }
 
 void SocketSet::close()
 {
-	for (vector<Socket>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
+	for (vector<Socket *>::iterator socket = connections.begin(); socket != connections.end(); ++socket)
 	{
-		::close((*socket).get_id());
+		::close((*socket)->get_id());
 	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (poller != -1)
+		::close(poller);
+#endif
 }
@@ -38,27 +38,53 @@
 #include <sys/select.h>
 
 #include "Socket.h"
+#include "TimerWheel.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 class SocketSet
 {
 	public:
 		SocketSet();
+		~SocketSet();
 		
+		void operator += (Socket * _socket);
 		void operator += (Socket & _socket);
 		void operator -= (Socket & _socket);
-		bool operator == (Socket & _socket);
 		
-		Socket & get_ready();
-		Socket & get_socket(int _socket);
+		void watch(int _fd);
+		Socket * get_socket(int _socket);
 		int get_status(int _timeout = 0);
+		void schedule(Socket & _socket);
+		void expire(double _now);
 		void send(const std::string & _data);
 		void close();
-		std::vector<Socket> connections;
+
+		// Connections are heap allocated and owned by the set, pointers stay valid until removal
+		std::vector<Socket *> connections;
+
+		// Descriptors reported by the last get_status() call
+		std::vector<int> ready;
 		
 	private:
+		// Position of each descriptor in connections, -1 if unused
+		std::vector<int> positions;
+
+		// Idle, handshake and write stall deadlines of every connection
+		TimerWheel timers;
+
+#ifdef HAVE_SYS_EPOLL_H
+		int poller;
+		std::vector<struct epoll_event> events;
+#else
+		std::vector<int> watched;
 		int highest;
 		fd_set readyset;
+		fd_set writeset;
 		fd_set socketset;
+#endif
 };
 
 #endif
@@ -58,6 +58,104 @@ void* start_stats_thread(void*a)
 	return 0;
 }
 
+// Collectors that don't share state are updated at the same time, see CollectorPool
+static void update_cpu(Stats *_stats)
+{
+	if(_stats->schedule.sampling(&_stats->cpuStats))
+	{
+		if(_stats->debugLogging)
+			cout << "Updating cpu" << endl;
+		_stats->cpuStats.update(_stats->sampleID);
+		_stats->processTicks += _stats->cpuStats.ticks;
+	}
+
+	// Processes need the cpu tick count since their last sample
+	if(_stats->schedule.sampling(&_stats->processStats))
+	{
+		if(_stats->debugLogging)
+			cout << "Updating processes" << endl;
+		_stats->processStats.update(_stats->sampleID, _stats->processTicks);
+		_stats->processTicks = 0;
+
+		_stats->processStats.finishUpdate();
+	}
+}
+
+static void update_load(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating load" << endl;
+	_stats->loadStats.update(_stats->sampleID);
+}
+
+static void update_memory(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating memory" << endl;
+	_stats->memoryStats.update(_stats->sampleID);
+}
+
+static void update_network(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating network" << endl;
+	_stats->networkStats.update(_stats->sampleID);
+}
+
+static void update_activity(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating activity" << endl;
+	_stats->activityStats.update(_stats->sampleID);
+}
+
+static void update_battery(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating battery" << endl;
+	_stats->batteryStats.update(_stats->sampleID);
+}
+
+static void update_disks(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating disks" << endl;
+	_stats->diskStats.update(_stats->sampleID);
+}
+
+static void update_sensors(Stats *_stats)
+{
+	if(_stats->debugLogging)
+		cout << "Updating sensors" << endl;
+	_stats->sensorStats.update(_stats->sampleID);
+}
+
+Stats::Stats()
+{
+	// Workers start before the stats thread, they see empty stats until the collectors have loaded
+	readers = NULL;
+	snapshot = new StatsSnapshot();
+	pthread_mutex_init(&readersLock, NULL);
+
+	collectorThreads = 0;
+	processTicks = 0;
+
+	// Slowest first, so it starts right away. Processes are updated in the
+	// same task as cpu, whose tick count they read.
+	CollectorTask *cpu = new CollectorTask("cpu+processes", update_cpu);
+	schedule.add("cpu", &cpuStats, cpu, 1);
+	schedule.add("processes", &processStats, cpu, 1);
+	schedule.add("activity", &activityStats, new CollectorTask("activity", update_activity), 1);
+	schedule.add("network", &networkStats, new CollectorTask("network", update_network), 1);
+	schedule.add("memory", &memoryStats, new CollectorTask("memory", update_memory), 1);
+	schedule.add("load", &loadStats, new CollectorTask("load", update_load), 1);
+
+	// Sensors, disks and battery change slowly, every third tick by default
+	schedule.add("sensors", &sensorStats, new CollectorTask("sensors", update_sensors), 3);
+	schedule.add("disks", &diskStats, new CollectorTask("disks", update_disks), 3);
+	schedule.add("battery", &batteryStats, new CollectorTask("battery", update_battery), 3);
+}
+
 void Stats::finalize()
 {
 	#ifdef USE_SQLITE
@@ -249,56 +347,42 @@ void Stats::startStats()
 	if(debugLogging)
 		cout << "Initital loading complete" << endl;
 
+	publish();
 
-	updateTime = get_current_time();
-	double next = ceil(updateTime) - updateTime;
-	updateTime = ceil(updateTime);
-	nextIPAddressTime = 0;//updateTime + 600;
-	double nextQueueTime = updateTime + 60;
+	// Processes are sampled along with cpu, so their period is a multiple of the cpu period
+	ScheduledCollector *cpu = schedule.find("cpu");
+	ScheduledCollector *processes = schedule.find("processes");
+	if (cpu->period > 1 && processes->period % cpu->period != 0)
+		processes->period += cpu->period - processes->period % cpu->period;
+	schedule.start(sampleID + 1);
 
-	updateNextTimes(updateTime);
-	usleep(next * 1000000);
+	timer.start();
+	nextIPAddressTime = 0;//updateTime + 600;
+	double nextQueueTime = timer.time + 60;
 
 	while(1){
-		pthread_mutex_lock(&lock);
+		// Seconds without a tick, after a suspend or a wall clock step, skip their sample ids
+		long long missed = timer.wait();
+		for (long long x = 0; x < missed; x++)
+		{
+			for (vector<ScheduledCollector *>::iterator collector = schedule.collectors.begin(); collector != schedule.collectors.end(); ++collector)
+				(*collector)->stats->tickSample();
+		}
+
+		updateTime = timer.time;
+		updateNextTimes(updateTime);
+
 		update_system_stats();
 		if(get_current_time() >= nextIPAddressTime)
 		{
 			nextIPAddressTime = updateTime + 600;
 			networkStats.updateAddresses();
 		}
-		pthread_mutex_unlock(&lock);
 
-		double now = get_current_time();
-		double next = updateTime + 1;
-		double interval = next - now;
-		if(interval < 0)
-		{
-			interval = ceil(now) < now;
-			next = ceil(now);
-		}
-		else if(interval > 2)
-		{
-			double n = next;
-			while(n < now)
-			{
-				cpuStats.tickSample();
-				loadStats.tickSample();
-				memoryStats.tickSample();
-				activityStats.tickSample();
-				sensorStats.tickSample();
-				networkStats.tickSample();
-				diskStats.tickSample();
-				batteryStats.tickSample();
-				n += 1;
-			}
-			interval = ceil(now) < now;
-			next = ceil(now);
-		}
+		publish();
 
-		updateTime = next;
-	
-		if(get_current_time() >= nextQueueTime)
+		double now = get_current_time();
+		if(now >= nextQueueTime)
 		{
 			#ifdef USE_SQLITE
 			if(debugLogging)
@@ -326,89 +410,139 @@ void Stats::startStats()
 //			nextQueueTime = now + 60;
 			nextQueueTime = now + 300;
 		}
-
-		updateNextTimes(updateTime);
-
-		usleep(interval * 1000000);
 	}
 }
 
 void Stats::start()
 {
 	updateTime = 0;
-	pthread_mutex_init(&lock, NULL);
-	pthread_create(&_thread, NULL, start_stats_thread, (void*)this);
-}
 
-void Stats::update_system_stats()
-{	
-#ifdef HAVE_LIBKSTAT
-	kstat_chain_update(ksh);
+#if defined(HAVE_LIBKSTAT) || defined(HAVE_LIBKVM)
+	// Collectors share one kstat or kvm handle, which can't be used from several threads
+	collectorThreads = 1;
 #endif
+#ifdef USE_SQLITE
+	// New items load their history while other collectors run
+	if (historyEnabled && sqlite3_threadsafe() == 0)
+		collectorThreads = 1;
+#endif
+	if (collectorThreads <= 0)
+		collectorThreads = (int)min(sysconf(_SC_NPROCESSORS_ONLN), 4L);
+	if (collectorThreads <= 0)
+		collectorThreads = 1;
+	collectors.start(collectorThreads - 1, this);
 
-	sampleID++;
+	pthread_create(&_thread, NULL, start_stats_thread, (void*)this);
+}
 
-	cpuStats.prepareUpdate();
-	loadStats.prepareUpdate();
-	memoryStats.prepareUpdate();
-	activityStats.prepareUpdate();
-	sensorStats.prepareUpdate();
-	networkStats.prepareUpdate();
+StatsReader * Stats::registerReader()
+{
+	StatsReader *reader = new StatsReader();
 
-	// not updated
-	processStats.prepareUpdate();
+	pthread_mutex_lock(&readersLock);
+	reader->next = readers;
+	readers = reader;
+	pthread_mutex_unlock(&readersLock);
 
-	if(debugLogging)
-		cout << "Updating cpu" << endl;
-	cpuStats.update(sampleID);
+	return reader;
+}
 
-	if(debugLogging)
-		cout << "Updating load" << endl;
-	loadStats.update(sampleID);
+const StatsSnapshot * Stats::pin(StatsReader *_reader)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	// Hazard pointer, once the pin is visible and the snapshot is still the
+	// latest one, publish() won't free it
+	StatsSnapshot *current = __atomic_load_n(&snapshot, __ATOMIC_SEQ_CST);
+	while (1)
+	{
+		__atomic_store_n(&_reader->pinned, current, __ATOMIC_SEQ_CST);
 
-	if(debugLogging)
-		cout << "Updating memory" << endl;
-	memoryStats.update(sampleID);
+		StatsSnapshot *latest = __atomic_load_n(&snapshot, __ATOMIC_SEQ_CST);
+		if (latest == current)
+			return current;
+		current = latest;
+	}
+#else
+	pthread_mutex_lock(&readersLock);
+	_reader->pinned = snapshot;
+	pthread_mutex_unlock(&readersLock);
+	return _reader->pinned;
+#endif
+}
 
-	if(debugLogging)
-		cout << "Updating network" << endl;
-	networkStats.update(sampleID);
+void Stats::unpin(StatsReader *_reader)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	__atomic_store_n(&_reader->pinned, (StatsSnapshot *)NULL, __ATOMIC_SEQ_CST);
+#else
+	pthread_mutex_lock(&readersLock);
+	_reader->pinned = NULL;
+	pthread_mutex_unlock(&readersLock);
+#endif
+}
 
-	if(debugLogging)
-		cout << "Updating activity" << endl;
-	activityStats.update(sampleID);
+void Stats::publish()
+{
+	StatsSnapshot *next = new StatsSnapshot(*this);
+	vector<StatsSnapshot *> unused;
+
+	pthread_mutex_lock(&readersLock);
+	retired.push_back(snapshot);
+#ifdef HAVE_ATOMIC_BUILTINS
+	__atomic_store_n(&snapshot, next, __ATOMIC_SEQ_CST);
+#else
+	snapshot = next;
+#endif
 
-	if(debugLogging)
-		cout << "Updating processes" << endl;
-	processStats.update(sampleID, cpuStats.ticks);
+	// Readers that pinned a retired snapshot before the swap are seen here
+	for (vector<StatsSnapshot *>::iterator old = retired.begin(); old != retired.end(); )
+	{
+		StatsReader *reader = readers;
+#ifdef HAVE_ATOMIC_BUILTINS
+		while (reader != NULL && __atomic_load_n(&reader->pinned, __ATOMIC_SEQ_CST) != *old)
+#else
+		while (reader != NULL && reader->pinned != *old)
+#endif
+			reader = reader->next;
 
-	processStats.finishUpdate();
+		if (reader == NULL)
+		{
+			unused.push_back(*old);
+			old = retired.erase(old);
+		}
+		else
+		{
+			++old;
+		}
+	}
+	pthread_mutex_unlock(&readersLock);
 
-    if((sampleID % 3) == 0)
-    {
-    	batteryStats.prepareUpdate();
-		diskStats.prepareUpdate();
-		sensorStats.prepareUpdate();
+	for (vector<StatsSnapshot *>::iterator old = unused.begin(); old != unused.end(); ++old)
+		delete *old;
+}
 
-		if(debugLogging)
-			cout << "Updating battery" << endl;
-		batteryStats.update(sampleID);
+void Stats::update_system_stats()
+{	
+#ifdef HAVE_LIBKSTAT
+	kstat_chain_update(ksh);
+#endif
 
-		if(debugLogging)
-			cout << "Updating disks" << endl;
-		diskStats.update(sampleID);
+	sampleID++;
 
-		if(debugLogging)
-			cout << "Updating sensors" << endl;
-		sensorStats.update(sampleID);
-	}
-	else
+	due.clear();
+	schedule.take(sampleID, due);
+
+	// Collectors sampled in this tick get a new sample id, the others only move their clock
+	for (vector<ScheduledCollector *>::iterator collector = schedule.collectors.begin(); collector != schedule.collectors.end(); ++collector)
 	{
-		sensorStats.tick();
-		diskStats.tick();
-		batteryStats.tick();		
+		if ((*collector)->sampling)
+			(*collector)->stats->prepareUpdate();
+		else
+			(*collector)->stats->tick();
 	}
 
+	collectors.run(due);
+
 	#ifdef USE_SQLITE
 	if(historyEnabled == true)
 	{
@@ -441,17 +575,8 @@ void Stats::insertDatabaseItems(StatsBase *collector)
 
 void Stats::updateNextTimes(double t)
 {
-	cpuStats.sampleIndex[0].nextTime = t;
-	loadStats.sampleIndex[0].nextTime = t;
-	memoryStats.sampleIndex[0].nextTime = t;
-	activityStats.sampleIndex[0].nextTime = t;
-	sensorStats.sampleIndex[0].nextTime = t;
-	networkStats.sampleIndex[0].nextTime = t;
-	diskStats.sampleIndex[0].nextTime = t;
-	batteryStats.sampleIndex[0].nextTime = t;
-	/*
-	processStats.sampleIndex[0].nextTime = t;
-	*/
+	for (vector<ScheduledCollector *>::iterator collector = schedule.collectors.begin(); collector != schedule.collectors.end(); ++collector)
+		(*collector)->stats->sampleIndex[0].nextTime = t;
 }
 
 long Stats::uptime()
@@ -50,6 +50,10 @@
 #include "stats/StatsActivity.h"
 #include "stats/StatsBattery.h"
 #include "stats/StatsProcesses.h"
+#include "StatsSnapshot.h"
+#include "CollectorPool.h"
+#include "CollectorSchedule.h"
+#include "TickTimer.h"
 
 #ifdef HAVE_KSTAT_H
 # include <kstat.h>
@@ -62,6 +66,7 @@
 class Stats
 {
 	public:
+		Stats();
 		void prepare();
 		void start();
 		void startStats();
@@ -70,14 +75,33 @@ class Stats
 		void close();
 		void finalize();
 
+		// Called once by each thread that reads snapshots
+		StatsReader * registerReader();
+
+		// The latest snapshot, valid until the reader unpins it. Never blocks.
+		const StatsSnapshot * pin(StatsReader *_reader);
+		void unpin(StatsReader *_reader);
+
 		std::vector<battery_info> get_battery_history(long _pos);
 		long uptime();
 		long long sampleID;
-		pthread_mutex_t lock;
 
 		bool historyEnabled;
 		bool debugLogging;
 
+		// Threads updating collectors, the stats thread included. 0 picks one per core, up to 4.
+		int collectorThreads;
+		CollectorPool collectors;
+
+		// Which collectors are sampled in each tick, periods are set from <name>_interval
+		CollectorSchedule schedule;
+
+		// Cpu ticks since processes were last sampled
+		double processTicks;
+
+		// Paces the stats thread on the monotonic clock
+		TickTimer timer;
+
 		#ifdef USE_SQLITE
 		Database _database;
 		void insertDatabaseItems(StatsBase *collector);
@@ -99,6 +123,18 @@ class Stats
 		kstat_ctl_t *ksh;
 #endif
 		pthread_t _thread;
+
+		// Builds a snapshot of the collectors and makes it the one readers pin
+		void publish();
+		StatsSnapshot *snapshot;
+		std::vector<StatsSnapshot *> retired;
+
+		// Guards the list of readers, which the stats thread walks to find pinned snapshots
+		pthread_mutex_t readersLock;
+		StatsReader *readers;
+
+		// Tasks of the collectors due in the current tick
+		std::vector<CollectorTask *> due;
 		double updateTime;
 		double nextIPAddressTime;
 };
@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "StatsSnapshot.h"
+#include "Stats.h"
+
+using namespace std;
+
+template <class T, class C>
+static void capture_series(SeriesSnapshot<T> &_snapshot, const C &_collector)
+{
+	_snapshot.session = _collector.session;
+	_snapshot.generation = _collector.generation;
+	for (int x = 0; x < 8; x++)
+	{
+		_snapshot.sampleIDs[x] = _collector.sampleIndex[x].sampleID;
+		_snapshot.samples[x] = _collector.samples[x];
+	}
+}
+
+template <class T, class C>
+static void capture_items(ItemsSnapshot<T> &_snapshot, const C &_collector)
+{
+	_snapshot.session = _collector.session;
+	_snapshot.generation = _collector.generation;
+	for (int x = 0; x < 8; x++)
+		_snapshot.sampleIDs[x] = _collector.sampleIndex[x].sampleID;
+	_snapshot.items = _collector._items;
+}
+
+static void capture_ranking(vector<process_info> &_rows, const StatsProcesses &_collector, const vector<size_t> &_ranking)
+{
+	_rows.reserve(_ranking.size());
+	for (size_t i = 0; i < _ranking.size(); i++)
+		_rows.push_back(_collector._items[_ranking[i]]);
+}
+
+// Runs on the stats thread, the only one that changes the collectors
+StatsSnapshot::StatsSnapshot(Stats &_stats)
+{
+	capture_series(cpu, _stats.cpuStats);
+	capture_series(memory, _stats.memoryStats);
+	capture_series(load, _stats.loadStats);
+	capture_items(network, _stats.networkStats);
+	capture_items(activity, _stats.activityStats);
+	capture_items(disks, _stats.diskStats);
+	capture_items(sensors, _stats.sensorStats);
+	capture_items(battery, _stats.batteryStats);
+
+	const StatsProcesses &processStats = _stats.processStats;
+	processes.generation = processStats.generation;
+	processes.sampleID = processStats._items.size() > 0 ? processStats._items.back().sampleID : 0;
+	processes.threadCount = processStats.threadCount;
+	processes.processCount = processStats.processCount;
+	capture_ranking(processes.cpu, processStats, processStats.cpuRanking);
+	capture_ranking(processes.memory, processStats, processStats.memoryRanking);
+
+	uptime = _stats.uptime();
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _STATSSNAPSHOT_H
+#define _STATSSNAPSHOT_H
+
+#include "config.h"
+#include <vector>
+
+#include "stats/StatsCPU.h"
+#include "stats/StatsMemory.h"
+#include "stats/StatsLoad.h"
+#include "stats/StatsNetwork.h"
+#include "stats/StatsActivity.h"
+#include "stats/StatsDisks.h"
+#include "stats/StatsSensors.h"
+#include "stats/StatsBattery.h"
+#include "stats/StatsProcesses.h"
+
+class Stats;
+
+// History of a collector without items
+template <class T>
+class SeriesSnapshot
+{
+	public:
+		SeriesSnapshot() : session(0), generation(0) { memset(sampleIDs, 0, sizeof(sampleIDs)); }
+
+		long session;
+		long long sampleIDs[8];
+		unsigned long long generation;
+		SampleRing<T> samples[8];
+};
+
+// Items of a collector, each with its own history
+template <class T>
+class ItemsSnapshot
+{
+	public:
+		ItemsSnapshot() : session(0), generation(0) { memset(sampleIDs, 0, sizeof(sampleIDs)); }
+
+		long session;
+		long long sampleIDs[8];
+		unsigned long long generation;
+		std::vector<T> items;
+};
+
+// Only the ranked rows of the process list are published
+class ProcessesSnapshot
+{
+	public:
+		ProcessesSnapshot() : generation(0), sampleID(0), threadCount(0), processCount(0) {}
+
+		unsigned long long generation;
+		long long sampleID;
+		long threadCount;
+		long processCount;
+		std::vector<process_info> cpu;
+		std::vector<process_info> memory;
+};
+
+// Everything responses are built from, as of one sample. The stats thread
+// publishes a new snapshot after every sample and never changes it after
+// that. Histories are shared with the collectors, nothing in them is copied.
+class StatsSnapshot
+{
+	public:
+		StatsSnapshot() : uptime(0) {}
+		StatsSnapshot(Stats &_stats);
+
+		SeriesSnapshot<cpu_data> cpu;
+		SeriesSnapshot<mem_data> memory;
+		SeriesSnapshot<load_data> load;
+		ItemsSnapshot<network_info> network;
+		ItemsSnapshot<activity_info> activity;
+		ItemsSnapshot<disk_info> disks;
+		ItemsSnapshot<sensor_info> sensors;
+		ItemsSnapshot<battery_info> battery;
+		ProcessesSnapshot processes;
+		long uptime;
+};
+
+// A thread that builds responses from published snapshots. The stats thread
+// frees a snapshot only once no reader has it pinned.
+class StatsReader
+{
+	public:
+		StatsReader() : pinned(NULL), next(NULL) {}
+
+		StatsSnapshot *pinned;
+		StatsReader *next;
+};
+
+#endif
@@ -34,6 +34,7 @@
 
 #include <time.h>
 #include <stdio.h>
+#include <string>
 
 #define SERVER_VERSION 3.03
 #define SERVER_BUILD 105
@@ -46,6 +47,9 @@ struct load_data
 	long long sampleID;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 struct cpu_data
@@ -54,6 +58,9 @@ struct cpu_data
 	long long sampleID;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 #define memory_value_total 0
@@ -87,6 +94,9 @@ struct mem_data
 	long long sampleID;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 struct activity_data
@@ -96,6 +106,9 @@ struct activity_data
 	double rIOPS, wIOPS;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 struct net_data
@@ -104,6 +117,9 @@ struct net_data
 	double u, d;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 struct disk_data
@@ -113,6 +129,9 @@ struct disk_data
 	double t, u, f;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 struct sensor_data
@@ -121,6 +140,9 @@ struct sensor_data
 	double value;
 	double time;
 	bool empty;
+
+	// The sample's <s> element, rendered once when it is recorded
+	std::string xml;
 };
 
 #endif
@@ -0,0 +1,136 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <sstream>
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+
+#include "TickTimer.h"
+#include "Utility.h"
+
+using namespace std;
+
+// Most a tick moves to follow the wall clock second, in seconds
+#define TICK_MAX_ADJUSTMENT 0.01
+
+static void sleep_until(double _deadline)
+{
+#if defined(HAVE_CLOCK_NANOSLEEP) && defined(CLOCK_MONOTONIC)
+	struct timespec until;
+	until.tv_sec = (time_t)_deadline;
+	until.tv_nsec = (long)((_deadline - until.tv_sec) * 1000000000.0);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+		;
+#else
+	double interval = _deadline - get_monotonic_time();
+	if (interval <= 0)
+		return;
+
+	struct timespec duration;
+	duration.tv_sec = (time_t)interval;
+	duration.tv_nsec = (long)((interval - duration.tv_sec) * 1000000000.0);
+
+	// Signal handlers interrupt the sleep, carry on with the time left
+	while (nanosleep(&duration, &duration) == -1 && errno == EINTR)
+		;
+#endif
+}
+
+TickTimer::TickTimer()
+{
+	time = 0;
+	deadline = 0;
+	jitterTotal = 0;
+	jitterSlowest = 0;
+	ticks = 0;
+	missed = 0;
+	overruns = 0;
+}
+
+void TickTimer::start()
+{
+	double now = get_current_time();
+	deadline = get_monotonic_time() + (ceil(now) - now);
+	time = ceil(now) - 1;
+}
+
+long long TickTimer::wait()
+{
+	// Late by whole ticks, the next one runs right away instead of catching up in a burst
+	double late = get_monotonic_time() - deadline;
+	if (late >= 1)
+	{
+		deadline += floor(late);
+		overruns += (unsigned long long)floor(late);
+	}
+
+	sleep_until(deadline);
+
+	double jitter = max(get_monotonic_time() - deadline, 0.0);
+	jitterTotal += jitter;
+	jitterSlowest = max(jitterSlowest, jitter);
+	ticks++;
+
+	double previous = time;
+	double now = get_current_time();
+	time = floor(now + 0.5);
+	if (time == previous)
+		time = previous + 1;
+
+	// Follow the wall clock second when NTP slews it, a little every tick
+	double offset = (now - jitter) - floor(now - jitter + 0.5);
+	deadline += 1 - max(-TICK_MAX_ADJUSTMENT, min(offset, TICK_MAX_ADJUSTMENT));
+
+	// The wall clock stepped back, samples follow it
+	if (time < previous)
+		return 0;
+
+	long long skipped = (long long)(time - previous) - 1;
+	missed += skipped;
+	return skipped;
+}
+
+string TickTimer::report()
+{
+	stringstream report;
+
+	report << "Ticks: " << ticks << ", " << missed << " seconds missed, " << overruns << " overruns";
+	if (ticks > 0)
+		report << "; jitter " << jitterTotal / ticks * 1000 << " ms average, " << jitterSlowest * 1000 << " ms slowest";
+
+	return report.str();
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _TICKTIMER_H
+#define _TICKTIMER_H
+
+#include "config.h"
+#include <string>
+
+// Paces the stats thread once a second against absolute deadlines on the
+// monotonic clock, so stepping the wall clock neither bursts nor stalls
+// sampling. The wall clock only stamps samples.
+class TickTimer
+{
+	public:
+		TickTimer();
+
+		// The first tick lands on the next whole wall clock second
+		void start();
+
+		// Sleeps until the next tick and returns the seconds without a tick
+		// since the previous one. Deadlines already passed are skipped.
+		long long wait();
+
+		// Wall clock second of the current tick, never the same as the previous one
+		double time;
+
+		// Wakeup jitter and missed ticks, logged on SIGUSR1
+		std::string report();
+
+	private:
+		double deadline;
+		double jitterTotal;
+		double jitterSlowest;
+		unsigned long long ticks;
+		unsigned long long missed;
+		unsigned long long overruns;
+};
+
+#endif
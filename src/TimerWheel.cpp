@@ -0,0 +1,80 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+
+#include "TimerWheel.h"
+
+using namespace std;
+
+TimerWheel::TimerWheel()
+{
+	slots.resize(TIMER_WHEEL_SLOTS);
+	current = -1;
+}
+
+void TimerWheel::schedule(int _fd, unsigned long long _serial, double _deadline)
+{
+	long long tick = (long long)_deadline;
+
+	// Deadlines already behind the wheel are picked up on the next drain
+	if (current >= 0 && tick < current)
+		tick = current;
+
+	slots[tick % TIMER_WHEEL_SLOTS].push_back(TimerEntry(_fd, _serial, _deadline));
+}
+
+// Moves every entry whose deadline has passed into _entries, only the slots elapsed since the last call are visited
+void TimerWheel::expired(double _now, vector<TimerEntry> &_entries)
+{
+	long long tick = (long long)_now;
+
+	if (current < 0 || tick - current >= TIMER_WHEEL_SLOTS)
+		current = tick - TIMER_WHEEL_SLOTS + 1;
+
+	for (; current <= tick; current++)
+	{
+		vector<TimerEntry> &slot = slots[current % TIMER_WHEEL_SLOTS];
+
+		size_t kept = 0;
+		for (size_t i = 0; i < slot.size(); i++)
+		{
+			if (slot[i].deadline <= _now)
+				_entries.push_back(slot[i]);
+			else
+				slot[kept++] = slot[i];
+		}
+		slot.resize(kept, TimerEntry(-1, 0, 0));
+	}
+
+	// The current second is visited again next time, it may still hold later deadlines
+	current = tick;
+}
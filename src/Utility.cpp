@@ -107,6 +107,16 @@ double get_current_time()
 	return (double)tp.tv_sec + ((double)tp.tv_usec / 1000000.f);
 }
 
+double get_monotonic_time()
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+		return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+#endif
+	return get_current_time();
+}
+
 string get_current_time_string()
 {
 	struct timeval tp;
@@ -285,6 +295,18 @@ vector<string> explode(string _source, const string &_delim)
 	return ret;
 }
 
+// FNV-1a, for lookups that compare the full value after a hash match
+unsigned long long hash_bytes(const char *_data, size_t _length)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < _length; i++)
+	{
+		hash ^= (unsigned char)_data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 int create_directory(const string &_dir, mode_t _mask)
 {
 	if (mkdir(_dir.c_str(), _mask) < 0)
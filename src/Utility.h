@@ -73,12 +73,16 @@ int check_dir_exist(const std::string & _dir);
 int check_file_exist(const std::string & _file);
 int create_directory(const std::string &_dir, mode_t _mask);
 double get_current_time();
+
+// Seconds on a clock that setting the wall clock does not move, for measuring intervals
+double get_monotonic_time();
 int serverPlatform();
 std::string get_current_time_string();
 
 std::string trim(const std::string & _source, const char * _delims = " \t\r\n");
 std::vector<std::string> split(const std::string &_str, const std::string _delim);
 std::vector<std::string> explode(std::string _str, const std::string &_delim = " ");
+unsigned long long hash_bytes(const char *_data, size_t _length);
 
 template<class T> double to_double(const T &_val)
 {
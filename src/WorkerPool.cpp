@@ -0,0 +1,205 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+
+#include "WorkerPool.h"
+#include "Responses.h"
+#include "ResponseCache.h"
+
+using namespace std;
+
+void* start_worker_thread(void*);
+void* start_worker_thread(void*a)
+{
+	WorkerPool *pool = static_cast<WorkerPool*>(a);
+	pool->run();
+	return 0;
+}
+
+WorkerPool::WorkerPool()
+{
+	stats = NULL;
+	wake[0] = -1;
+	wake[1] = -1;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&available, NULL);
+}
+
+int WorkerPool::start(int _threads, Stats *_stats)
+{
+	stats = _stats;
+
+	if (pipe(wake) == -1)
+	{
+		cout << "Could not create worker pipe: " << strerror(errno) << endl;
+		return 0;
+	}
+
+	fcntl(wake[0], F_SETFL, fcntl(wake[0], F_GETFL, 0) | O_NONBLOCK);
+	fcntl(wake[1], F_SETFL, fcntl(wake[1], F_GETFL, 0) | O_NONBLOCK);
+
+	for (int i = 0; i < _threads; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, start_worker_thread, (void*)this) != 0)
+		{
+			cout << "Could not start worker thread: " << strerror(errno) << endl;
+			break;
+		}
+		threads.push_back(thread);
+	}
+
+	return threads.size() > 0;
+}
+
+void WorkerPool::submit(ResponseJob *_job)
+{
+	pthread_mutex_lock(&lock);
+	pending.push_back(_job);
+	pthread_cond_signal(&available);
+	pthread_mutex_unlock(&lock);
+}
+
+void WorkerPool::completed(vector<ResponseJob *> &_jobs)
+{
+	char buf[64];
+
+	// Drain the pipe first, a job finishing after this still writes a new byte
+	while (read(wake[0], buf, sizeof(buf)) > 0);
+
+	pthread_mutex_lock(&lock);
+	_jobs.insert(_jobs.end(), finished.begin(), finished.end());
+	finished.clear();
+	pthread_mutex_unlock(&lock);
+}
+
+void WorkerPool::run()
+{
+	// Kept for the life of the thread so building and compressing a response reuses their memory
+	OutputBuffer output;
+	OutputBuffer key;
+	Compressor compressor;
+	StatsReader *reader = stats->registerReader();
+
+	while (1)
+	{
+		pthread_mutex_lock(&lock);
+		while (pending.empty())
+			pthread_cond_wait(&available, &lock);
+
+		ResponseJob *job = pending.front();
+		pending.pop_front();
+		pthread_mutex_unlock(&lock);
+
+		process(job, output, key, compressor, reader);
+
+		pthread_mutex_lock(&lock);
+		bool notify = finished.empty();
+		finished.push_back(job);
+		pthread_mutex_unlock(&lock);
+
+		// One byte is enough while earlier results are still waiting to be collected
+		if (notify && write(wake[1], "", 1) == -1 && errno != EAGAIN)
+			cout << "Could not wake main thread: " << strerror(errno) << endl;
+	}
+}
+
+void WorkerPool::process(ResponseJob *_job, OutputBuffer &_output, OutputBuffer &_key, Compressor &_compressor, StatsReader *_reader)
+{
+	_output.clear();
+	_key.clear();
+
+	double cpuUsage = 0;
+
+	// The stats thread keeps sampling meanwhile, the response is built from one sample
+	const StatsSnapshot *snapshot = stats->pin(_reader);
+
+	isr_request_fingerprint(_key, _job->request, snapshot, _job->authenticated);
+	if (FindCachedResponse(_key.str(), _job->header, _job->data))
+	{
+		stats->unpin(_reader);
+		return;
+	}
+
+	// Compress harder when the machine has CPU to spare
+	if (snapshot->cpu.samples[0].size() > 0)
+	{
+		const cpu_data &cpu = snapshot->cpu.samples[0].front();
+		cpuUsage = cpu.u + cpu.s + cpu.n;
+	}
+
+	// Responses that outgrow COMPRESSION_LARGE_SIZE are compressed as they are built,
+	// the whole payload is never held uncompressed
+	if (_compressor.can_stream())
+	{
+		_compressor.begin(compression_level(COMPRESSION_LARGE_SIZE + 1, cpuUsage), _job->data.chunks());
+		_output.set_sink(&_compressor, COMPRESSION_LARGE_SIZE);
+	}
+
+	isr_stats_data(_output, _job->request, snapshot, _job->authenticated);
+	_output.set_sink(NULL, 0);
+
+	bool streamed = _compressor.streaming();
+	bool compressed = false;
+	if (streamed)
+	{
+		compressed = _compressor.finish(_output.str()) == 1;
+		if (!compressed)
+		{
+			// Part of the response only exists in the failed stream, build it again from the same sample
+			cout << "Could not compress response, sending it uncompressed" << endl;
+			_job->data.clear();
+			_output.clear();
+			isr_stats_data(_output, _job->request, snapshot, _job->authenticated);
+			_job->data.chunks().push_back(_output.str());
+		}
+	}
+
+	stats->unpin(_reader);
+
+	if (!streamed)
+	{
+		int level = compression_level(_output.size(), cpuUsage);
+		compressed = _compressor.compress(_output.str(), level, _job->data.chunks()) == 1;
+		if (!compressed)
+			_job->data.chunks().push_back(_output.str());
+	}
+
+	_job->header = isr_stats_header(_job->data.size(), compressed);
+
+	CacheResponse(_key.str(), _job->header, _job->data);
+}
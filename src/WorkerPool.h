@@ -0,0 +1,90 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _WORKERPOOL_H
+#define _WORKERPOOL_H
+
+#include "config.h"
+#include <deque>
+#include <vector>
+#include <string>
+#include <pthread.h>
+
+#include "Stats.h"
+#include "Request.h"
+#include "OutputBuffer.h"
+#include "Compression.h"
+#include "ResponseData.h"
+
+class ResponseJob
+{
+	public:
+		ResponseJob(int _socket, unsigned long long _serial, bool _authenticated) : socket(_socket), serial(_serial), authenticated(_authenticated) {}
+
+		// Connection the response belongs to, the serial guards against reused descriptors
+		int socket;
+		unsigned long long serial;
+
+		// Swapped in from the connection, which takes it back once the response is queued
+		Request request;
+		bool authenticated;
+
+		// The 105 header, then the payload in chunks written one after the other
+		std::string header;
+		ResponseData data;
+};
+
+class WorkerPool
+{
+	public:
+		WorkerPool();
+
+		int start(int _threads, Stats *_stats);
+		void submit(ResponseJob *_job);
+		void completed(std::vector<ResponseJob *> &_jobs);
+		void run();
+
+		// Readable whenever finished jobs are waiting to be collected
+		int get_id() { return wake[0]; }
+
+	private:
+		void process(ResponseJob *_job, OutputBuffer &_output, OutputBuffer &_key, Compressor &_compressor, StatsReader *_reader);
+
+		Stats *stats;
+		int wake[2];
+		pthread_mutex_t lock;
+		pthread_cond_t available;
+		std::deque<ResponseJob *> pending;
+		std::deque<ResponseJob *> finished;
+		std::vector<pthread_t> threads;
+};
+
+#endif
@@ -44,6 +44,10 @@
 #include "Clientset.h"
 #include "Avahi.h"
 #include "Socketset.h"
+#include "SessionTickets.h"
+#include "Compression.h"
+#include "ResponseCache.h"
+#include "EventLoop.h"
 #include <unistd.h> 
 
 #include <iostream>
@@ -67,7 +71,6 @@ SignalResponder * pn_signalresponder = NULL;
 int main(int argc, char ** argv)
 {
 	Stats stats;
-	SocketSet sockets;
 	ClientSet clients;
 	ArgumentSet arguments(argc, argv);
 
@@ -130,6 +133,12 @@ int main(int argc, char ** argv)
 	string cf_server_pid = arguments.get("pid", config.get("server_pid", "/var/run/istatserver.pid"));
 
 	string cf_server_socket = arguments.get("socket", config.get("server_socket", "/tmp/istatserver.sock"));
+	int cf_worker_threads = to_int(config.get("worker_threads", "0"));
+	int cf_network_listeners = to_int(config.get("network_listeners", "1"));
+	int cf_network_backlog = to_int(config.get("network_backlog", "5"));
+	int cf_response_cache_size = to_int(config.get("response_cache_size", "32"));
+	int cf_response_cache_bytes = to_int(config.get("response_cache_bytes", "4194304"));
+	int cf_collector_threads = to_int(config.get("collector_threads", "0"));
 
 	// Load server generated config file
 	string generated_path = config_directory + "istatserver_generated.conf";
@@ -155,9 +164,19 @@ int main(int argc, char ** argv)
 		free(uuid);
 	}
 
+	if (cf_network_listeners <= 0)
+		cf_network_listeners = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cf_network_listeners <= 0)
+		cf_network_listeners = 1;
+
+	// The main thread runs the first loop, the others get a thread each
+	vector<EventLoop *> loops;
+	for (int i = 0; i < cf_network_listeners; i++)
+		loops.push_back(new EventLoop(&clients, &config, &stats));
+
 	Socket listener(cf_network_addr, to_int(cf_network_port));
 	Daemon unixdaemon(cf_server_pid, cf_server_socket);
-	SignalResponder signalresponder(&sockets, &listener, &unixdaemon, &stats);
+	SignalResponder signalresponder(&loops[0]->sockets, &loops[0]->listener, &unixdaemon, &stats);
 	
 	::pn_signalresponder = &signalresponder;
 
@@ -171,8 +190,24 @@ int main(int argc, char ** argv)
 	stats.diskStats.customNames = config.get_array("disk_rename_label");
 	stats.diskStats.disableFiltering = to_int(config.get("disk_disable_filtering", "0"));
 
+	int cf_disk_probe_timeout = to_int(config.get("disk_probe_timeout", "500"));
+	if (cf_disk_probe_timeout > 0)
+		stats.diskStats.probeTimeout = cf_disk_probe_timeout;
+
+	int cf_process_top_count = to_int(config.get("process_top_count", "20"));
+	if (cf_process_top_count > 0)
+		stats.processStats.rankingSize = cf_process_top_count;
+
 	stats.debugLogging = false;
 	stats.sampleID = 0;
+	stats.collectorThreads = cf_collector_threads;
+
+	for (vector<ScheduledCollector *>::iterator collector = stats.schedule.collectors.begin(); collector != stats.schedule.collectors.end(); ++collector)
+	{
+		int period = to_int(config.get(string((*collector)->name) + "_interval", "0"));
+		if (period > 0)
+			(*collector)->period = period;
+	}
 
 	bool debugSocket = false;
 	bool debugStats = false;
@@ -230,74 +265,81 @@ int main(int argc, char ** argv)
 	string privateKeyPath = string(CONFIG_PATH) + "key.pem";
 	string certPath = string(CONFIG_PATH) + "cert.pem";
 
-	listener.sslContext = InitServerCTX();
-	if(listener.sslContext != NULL)
+	// One context is shared by every connection, each loop hands it to the sockets it accepts
+	SSL_CTX *context = CreateServerCTX(certPath, privateKeyPath);
+	if(context != NULL)
 	{
-		if(access(certPath.c_str(), F_OK) == -1)
-		{
-			createSSLCertificate();
-		}
-
-		LoadCertificates(listener.sslContext, (char *)certPath.c_str(), (char *)privateKeyPath.c_str());
 		listener._sslEnabled = 1;
 	}
 
-	if (!listener.listen()) return 1;
-	
-	sockets += listener;
+	// The fallback request parser runs on every event loop's thread, libxml is set up once before they start
+	xmlInitParser();
+
+	if (cf_worker_threads <= 0)
+		cf_worker_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cf_worker_threads <= 0)
+		cf_worker_threads = 1;
+
+	if (cf_response_cache_size < 0)
+		cf_response_cache_size = 0;
+	if (cf_response_cache_bytes < 0)
+		cf_response_cache_bytes = 0;
+	InitResponseCache(cf_response_cache_size, cf_response_cache_bytes);
 
+	// Workers are split between the loops, each loop needs at least one
+	int loop_threads = cf_worker_threads / cf_network_listeners;
+	if (loop_threads <= 0)
+		loop_threads = 1;
+
+	for (vector<EventLoop *>::iterator loop = loops.begin(); loop != loops.end(); ++loop)
+	{
+		if (!(*loop)->start(listener, cf_network_backlog, cf_network_listeners > 1, loop_threads)) return 1;
+		(*loop)->set_context(context);
+	}
+
+	// The loops hold their own references
+	if (context != NULL)
+		SSL_CTX_free(context);
 
 	stats.start();
 
+	for (size_t i = 1; i < loops.size(); i++)
+	{
+		if (!loops[i]->spawn()) return 1;
+	}
+
 	while (1)
 	{
-		if (sockets.get_status(1) > 0)
+		if (signalresponder.reloadPending)
 		{
-			if (sockets == listener)
+			signalresponder.reloadPending = 0;
+
+			context = CreateServerCTX(certPath, privateKeyPath);
+			if (context != NULL)
 			{
-				Socket new_socket = listener.accept();
-				new_socket.debugLogging = debugSocket;
-				new_socket.sslContext = InitServerCTX();
-				LoadCertificates(new_socket.sslContext, (char *)certPath.c_str(), (char *)privateKeyPath.c_str());
-				new_socket.startSSL();
-				sockets += new_socket;
+				for (vector<EventLoop *>::iterator loop = loops.begin(); loop != loops.end(); ++loop)
+					(*loop)->set_context(context);
+
+				SSL_CTX_free(context);
+				cout << "Reloaded TLS certificate." << endl;
 			}
 			else
 			{
-				Socket &active_socket = sockets.get_ready();
-
-				if (active_socket.receive(&clients, &config, &stats))
-				{
-				}
-				else
-				{
-					sockets -= active_socket;
-				}
+				cout << "Could not reload TLS certificate, keeping the current one." << endl;
 			}
 		}
 
-		bool finished = false;
-		while(finished == false)
+		if (signalresponder.reportPending)
 		{
-			finished = true;
-
-			vector<Socket>::iterator it = sockets.connections.begin();
-			while(it != sockets.connections.end())
-			{
-				if((*it).isServer == true)
-				{
-					++it;
-					continue;
-				}
-		    	if((*it).lastRequest < (get_current_time() - 120)){
-		    		cout << (*it).get_description() << " Removing connection due to timeout: " << (long long)(get_current_time() - (*it).lastRequest) << endl;
-		    	    sockets -= (*it);
-		    	    finished = false;
-		    	    break;
-	   			}
-			    ++it;
-			}		
+			signalresponder.reportPending = 0;
+			cout << get_current_time_string() << " - " << SessionReport() << endl;
+			cout << get_current_time_string() << " - " << CompressionReport() << endl;
+			cout << get_current_time_string() << " - " << ResponseCacheReport() << endl;
+			cout << get_current_time_string() << " - " << stats.collectors.report() << endl;
+			cout << get_current_time_string() << " - " << stats.timer.report() << endl;
 		}
+
+		loops[0]->poll();
 	}
 
 	::pn_signalresponder = NULL;
@@ -328,7 +370,10 @@ SSL_CTX* InitServerCTX(void)
         return NULL;
     }
 
-    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    InitSessionCache(ctx);
+
+    // Output is queued per connection, and may be resumed from a different offset
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
     // Legacy: set temporary ECDH params via EC_KEY (pre-1.1.0)
@@ -411,25 +456,46 @@ DH *get_dh2236()
 }
 #endif
 
-void LoadCertificates(SSL_CTX* ctx, char* CertFile, char* KeyFile)
+int LoadCertificates(SSL_CTX* ctx, char* CertFile, char* KeyFile)
 {
     if ( SSL_CTX_use_certificate_file(ctx, CertFile, SSL_FILETYPE_PEM) <= 0 )
     {
         ERR_print_errors_fp(stdout);
         fflush(stdout);
-        return;
+        return 0;
     }
     if ( SSL_CTX_use_PrivateKey_file(ctx, KeyFile, SSL_FILETYPE_PEM) <= 0 )
     {
         ERR_print_errors_fp(stdout);
         fflush(stdout);
-        return;
+        return 0;
     }
     if ( !SSL_CTX_check_private_key(ctx) )
     {
         cout << "Private key does not match the public certificate" << endl;
-        return;
+        return 0;
     }
+    return 1;
+}
+
+SSL_CTX* CreateServerCTX(const string &certPath, const string &keyPath)
+{
+	SSL_CTX *ctx = InitServerCTX();
+	if (ctx == NULL)
+		return NULL;
+
+	if(access(certPath.c_str(), F_OK) == -1)
+	{
+		createSSLCertificate();
+	}
+
+	if (!LoadCertificates(ctx, (char *)certPath.c_str(), (char *)keyPath.c_str()))
+	{
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
 }
 
 void handler(int _signal)
@@ -449,6 +515,10 @@ void handler(int _signal)
 			case SIGHUP:
 				pn_signalresponder->on_sighup();
 				return;
+
+			case SIGUSR1:
+				pn_signalresponder->on_sigusr1();
+				return;
 		}
 	}
 }
@@ -38,7 +38,8 @@
 void handler(int _signal);
 void GenerateGuid(char *guidStr);
 SSL_CTX* InitServerCTX(void);
-void LoadCertificates(SSL_CTX* ctx, char* CertFile, char* KeyFile);
+int LoadCertificates(SSL_CTX* ctx, char* CertFile, char* KeyFile);
+SSL_CTX* CreateServerCTX(const std::string &certPath, const std::string &keyPath);
 DH *get_dh2236();
 
 #endif
@@ -0,0 +1,229 @@
+/*
+ *  Copyright 2016 Bjango Pty Ltd. All rights reserved.
+ *  Copyright 2010 William Tisäter. All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *    1.  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *    2.  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ *    3.  The name of the copyright holder may not be used to endorse or promote
+ *        products derived from this software without specific prior written
+ *        permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY
+ *  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL WILLIAM TISÄTER BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _SAMPLERING_H
+#define _SAMPLERING_H
+
+#include <stddef.h>
+#include <vector>
+
+// Samples per chunk of a SampleRing
+#define SAMPLE_CHUNK_SIZE 32
+
+// Fixed block of samples. Slots are filled from the end towards the start and
+// never written again, so a chunk can be shared by any number of rings.
+template <class T>
+class SampleChunk
+{
+	public:
+		SampleChunk() : references(1), first(SAMPLE_CHUNK_SIZE) {}
+
+		int references;
+
+		// Lowest slot written so far
+		int first;
+		T slots[SAMPLE_CHUNK_SIZE];
+};
+
+// Chunks of a ring, oldest first. Shared between copies of a ring until one
+// of them has to add or drop a chunk.
+template <class T>
+class SampleDirectory
+{
+	public:
+		SampleDirectory() : references(1) {}
+		SampleDirectory(const SampleDirectory &_other) : references(1), chunks(_other.chunks)
+		{
+			for (size_t i = 0; i < chunks.size(); i++)
+				chunks[i]->references++;
+		}
+
+		~SampleDirectory()
+		{
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				if (--chunks[i]->references == 0)
+					delete chunks[i];
+			}
+		}
+
+		int references;
+		std::vector<SampleChunk<T> *> chunks;
+
+	private:
+		SampleDirectory & operator = (const SampleDirectory &);
+};
+
+// Newest first history of a collector, used like the std::deque it replaces.
+// Copying a ring shares its samples instead of copying them, later changes to
+// either copy are not seen by the other. Reference counts are not atomic, only
+// the stats thread may copy, change or destroy rings. Other threads may read
+// a ring for as long as the stats thread keeps that copy alive.
+template <class T>
+class SampleRing
+{
+	public:
+		class const_iterator
+		{
+			public:
+				const_iterator(const SampleRing *_ring, size_t _index) : ring(_ring), index(_index) {}
+
+				const T & operator * () const { return (*ring)[index]; }
+				const T * operator -> () const { return &(*ring)[index]; }
+				const_iterator & operator ++ () { index++; return *this; }
+				bool operator == (const const_iterator &_other) const { return index == _other.index; }
+				bool operator != (const const_iterator &_other) const { return index != _other.index; }
+
+			private:
+				const SampleRing *ring;
+				size_t index;
+		};
+
+		SampleRing() : directory(NULL), head(0), count(0) {}
+		SampleRing(const SampleRing &_other) : directory(_other.directory), head(_other.head), count(_other.count)
+		{
+			if (directory)
+				directory->references++;
+		}
+
+		~SampleRing() { release(); }
+
+		SampleRing & operator = (const SampleRing &_other)
+		{
+			if (_other.directory)
+				_other.directory->references++;
+			release();
+			directory = _other.directory;
+			head = _other.head;
+			count = _other.count;
+			return *this;
+		}
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		const T & operator [] (size_t i) const
+		{
+			// Positions count from the newest sample, which sits at slot head of the last chunk
+			size_t position = head + i;
+			return directory->chunks[directory->chunks.size() - 1 - position / SAMPLE_CHUNK_SIZE]->slots[position % SAMPLE_CHUNK_SIZE];
+		}
+
+		const T & front() const { return (*this)[0]; }
+		const T & back() const { return (*this)[count - 1]; }
+
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, count); }
+
+		void push_front(const T &_sample)
+		{
+			if (count == 0 || head == 0)
+			{
+				unshare();
+				directory->chunks.push_back(new SampleChunk<T>());
+				head = SAMPLE_CHUNK_SIZE;
+			}
+			else if (directory->chunks.back()->first != (int)head)
+			{
+				// Another copy of the ring already wrote below head, the newest chunk is copied
+				unshare();
+				SampleChunk<T> *shared = directory->chunks.back();
+				SampleChunk<T> *chunk = new SampleChunk<T>();
+				for (size_t i = head; i < SAMPLE_CHUNK_SIZE; i++)
+					chunk->slots[i] = shared->slots[i];
+				chunk->first = head;
+				directory->chunks.back() = chunk;
+				if (--shared->references == 0)
+					delete shared;
+			}
+
+			SampleChunk<T> *chunk = directory->chunks.back();
+			head--;
+			chunk->slots[head] = _sample;
+			chunk->first = head;
+			count++;
+		}
+
+		void pop_back()
+		{
+			if (count == 0)
+				return;
+
+			count--;
+			if (count == 0)
+			{
+				release();
+				head = 0;
+				return;
+			}
+
+			// Drop the oldest chunk once nothing in it is part of the ring anymore
+			size_t used = (head + count + SAMPLE_CHUNK_SIZE - 1) / SAMPLE_CHUNK_SIZE;
+			if (directory->chunks.size() > used)
+			{
+				unshare();
+				SampleChunk<T> *chunk = directory->chunks.front();
+				directory->chunks.erase(directory->chunks.begin());
+				if (--chunk->references == 0)
+					delete chunk;
+			}
+		}
+
+	private:
+		// Makes sure this ring is the only user of its directory
+		void unshare()
+		{
+			if (directory == NULL)
+			{
+				directory = new SampleDirectory<T>();
+			}
+			else if (directory->references > 1)
+			{
+				directory->references--;
+				directory = new SampleDirectory<T>(*directory);
+			}
+		}
+
+		void release()
+		{
+			if (directory && --directory->references == 0)
+				delete directory;
+			directory = NULL;
+		}
+
+		SampleDirectory<T> *directory;
+
+		// Slot of the newest sample in the newest chunk
+		size_t head;
+		size_t count;
+};
+
+#endif
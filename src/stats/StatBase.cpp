@@ -33,18 +33,111 @@
 
 using namespace std;
 
+void render_sample(load_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" one=\"" << sample.one << "\" five=\"" << sample.two << "\" fifteen=\"" << sample.three << "\"></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(cpu_data &sample, bool lpar)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" u=\"" << sample.u << "\" s=\"" << sample.s << "\" n=\"" << sample.n << "\" io=\"" << sample.io << "\"";
+
+	// Only AIX partitions report entitlement, hasLpar is false everywhere else
+	if(lpar)
+		output << " ent=\"" << sample.ent << "\" phys=\"" << sample.phys << "\"";
+
+	output << "></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(mem_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\"";
+
+	if(sample.values[memory_value_file] >= 0)
+		output << " file=\"" << sample.values[memory_value_file] << "\"";
+	if(sample.values[memory_value_ex] >= 0)
+		output << " ex=\"" << sample.values[memory_value_ex] << "\"";
+	if(sample.values[memory_value_buffer] >= 0)
+		output << " buf=\"" << sample.values[memory_value_buffer] << "\"";
+	if(sample.values[memory_value_used] >= 0)
+		output << " u=\"" << sample.values[memory_value_used] << "\"";
+	if(sample.values[memory_value_wired] >= 0)
+		output << " w=\"" << sample.values[memory_value_wired] << "\"";
+	if(sample.values[memory_value_cached] >= 0)
+		output << " ca=\"" << sample.values[memory_value_cached] << "\"";
+	if(sample.values[memory_value_active] >= 0)
+		output << " a=\"" << sample.values[memory_value_active] << "\"";
+	if(sample.values[memory_value_inactive] >= 0)
+		output << " i=\"" << sample.values[memory_value_inactive] << "\"";
+	if(sample.values[memory_value_free] >= 0)
+		output << " f=\"" << sample.values[memory_value_free] << "\"";
+	if(sample.values[memory_value_total] >= 0)
+		output << " t=\"" << sample.values[memory_value_total] << "\"";
+	if(sample.values[memory_value_swapused] >= 0)
+		output << " su=\"" << sample.values[memory_value_swapused]  << "\"";
+	if(sample.values[memory_value_swaptotal] >= 0)
+		output << " st=\"" << sample.values[memory_value_swaptotal] << "\"";
+	if(sample.values[memory_value_swapin] >= 0)
+		output << " pi=\"" << sample.values[memory_value_swapin] << "\"";
+	if(sample.values[memory_value_swapin] >= 0)
+		output << " po=\"" << sample.values[memory_value_swapout] << "\"";
+	if(sample.values[memory_value_virtualtotal] >= 0)
+		output << " vt=\"" << sample.values[memory_value_virtualtotal] << "\"";
+	if(sample.values[memory_value_virtualactive] >= 0)
+		output << " va=\"" << sample.values[memory_value_virtualactive] << "\"";
+
+	output << "></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(activity_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" r=\"" << sample.r << "\" w=\"" << sample.w << "\"></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(net_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" d=\"" << sample.d << "\" u=\"" << sample.u << "\"></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(disk_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" f=\"" << sample.f << "\" u=\"" << sample.u << "\" s=\"" << sample.t << "\" p=\"" << sample.p << "\"></s>";
+	sample.xml = output.str();
+}
+
+void render_sample(sensor_data &sample)
+{
+	stringstream output;
+	output << "<s id=\"" << sample.sampleID << "\" time=\"" << (long long)sample.time << "\" v=\"" << sample.value << "\"></s>";
+	sample.xml = output.str();
+}
+
 void StatsBase::tickSample()
 {
+	generation++;
 	sampleIndex[0].sampleID = sampleIndex[0].sampleID + 1;
 }
 
 void StatsBase::tick()
 {
+	generation++;
 	sampleIndex[0].time = sampleIndex[0].nextTime;
 }
 
 void StatsBase::prepareUpdate()
 {
+	generation++;
 	sampleIndex[0].time = sampleIndex[0].nextTime;
 	sampleIndex[0].sampleID = sampleIndex[0].sampleID + 1;
 }
@@ -49,6 +49,7 @@
 #include "config.h"
 #include "System.h"
 #include "Utility.h"
+#include "SampleRing.h"
 
 // needed for solaris
 #define _STRUCTURED_PROC 1
@@ -261,6 +262,16 @@
 #include "Database.h"
 #endif
 
+// Render a sample's <s> element. Samples are rendered once when recorded,
+// every client is then sent the same bytes.
+void render_sample(load_data &sample);
+void render_sample(cpu_data &sample, bool lpar);
+void render_sample(mem_data &sample);
+void render_sample(activity_data &sample);
+void render_sample(net_data &sample);
+void render_sample(disk_data &sample);
+void render_sample(sensor_data &sample);
+
 class StatsBase
 {
 	typedef struct sampleindexconfig {
@@ -272,10 +283,17 @@ class StatsBase
 	} sampleindexconfig_t;
 
 	public:
-		void prepareUpdate();
+		StatsBase() : generation(0) {}
+		virtual ~StatsBase() {}
+
+		// Overridden by collectors that reset their items before a sample, called through the schedule
+		virtual void prepareUpdate();
 		void tick();
 		void tickSample();
 		struct sampleindexconfig sampleIndex[8];
+
+		// Bumped whenever the collector's samples or sample ids change
+		unsigned long long generation;
 		void initShared();
 		int ready;
 		long session;
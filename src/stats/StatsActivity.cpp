@@ -406,6 +406,7 @@ void StatsActivity::createDisk(string key)
 				sample.wIOPS = query.doubleForColumn("writeiops");
 				sample.sampleID = query.doubleForColumn("sample");
 				sample.time = query.doubleForColumn("time");
+				render_sample(sample);
 				item.samples[x].push_front(sample);
 			}
 		}
@@ -476,6 +477,7 @@ void StatsActivity::processDisk(string key, long long sampleID, unsigned long lo
 			data.sampleID = sampleIndex[0].sampleID;
 			data.time = sampleIndex[0].time;
 
+			render_sample(data);
 			(*cur).samples[0].push_front(data);
 			if ((*cur).samples[0].size() > HISTORY_SIZE)
 				(*cur).samples[0].pop_back();
@@ -548,7 +550,7 @@ void StatsActivity::loadPreviousSamplesAtIndex(int index)
 		sample_data sample;
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -582,6 +584,7 @@ void StatsActivity::updateHistory()
 					{
 						activity_data sample = historyItemAtIndex(x, (*cur));
 
+						render_sample(sample);
 						(*cur).samples[x].push_front(sample);	
 						if ((*cur).samples[x].size() > HISTORY_SIZE) (*cur).samples[x].pop_back();
 
@@ -624,7 +627,7 @@ activity_data StatsActivity::historyItemAtIndex(int index, activity_info item)
 	double rIOPS = 0;
 	double wIOPS = 0;
 
-	std::deque<activity_data> from = item.samples[sampleIndex[index].historyIndex];
+	const SampleRing<activity_data> &from = item.samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -633,7 +636,7 @@ activity_data StatsActivity::historyItemAtIndex(int index, activity_info item)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<activity_data>::iterator cursample = from.begin(); cursample != from.end(); ++cursample)
+		for (SampleRing<activity_data>::const_iterator cursample = from.begin(); cursample != from.end(); ++cursample)
 		{
 			if ((*cursample).time > maximumTime)
 				continue;
@@ -49,7 +49,7 @@ class activity_info
 		
 		std::string device;		
 		std::vector<std::string> mounts;
-	   	std::deque<activity_data> samples[8];
+	   	SampleRing<activity_data> samples[8];
 };
 
 class StatsActivity : public StatsBase
@@ -384,6 +384,7 @@ void StatsCPU::update(long long sampleID)
 	_cpu.time = sampleIndex[0].time;
 
 
+	render_sample(_cpu, hasLpar);
 	samples[0].push_front(_cpu);	
 	if (samples[0].size() > HISTORY_SIZE) samples[0].pop_back();
 }/*USE_CPU_PERFSTAT*/
@@ -404,6 +405,7 @@ void StatsCPU::update(long long sampleID)
 void StatsCPU::_init()
 {	
 	initShared();
+	hasLpar = false;
 
 	last_ticks[0] = 0; last_ticks[1] = 0; last_ticks[2] = 0; last_ticks[3] = 0; last_ticks[4] = 0;
 
@@ -460,7 +462,8 @@ void StatsCPU::loadPreviousSamplesAtIndex(int index)
 		sample.io = query.doubleForColumn("wait");
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		render_sample(sample, hasLpar);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -522,6 +525,7 @@ void StatsCPU::processSample(long long sampleID, unsigned long long user, unsign
 		last_ticks[4] = wait;
 	}
 
+	render_sample(_cpu, hasLpar);
 	samples[0].push_front(_cpu);	
 	if (samples[0].size() > HISTORY_SIZE) samples[0].pop_back();
 }
@@ -546,6 +550,7 @@ void StatsCPU::updateHistory()
 					continue;
 
 				cpu_data sample = historyItemAtIndex(x);
+				render_sample(sample, hasLpar);
 				samples[x].push_front(sample);	
 				if (samples[x].size() > HISTORY_SIZE) samples[x].pop_back();
 
@@ -571,7 +576,7 @@ void StatsCPU::updateHistory()
 
 cpu_data StatsCPU::historyItemAtIndex(int index)
 {
-	std::deque<cpu_data> from = samples[sampleIndex[index].historyIndex];
+	const SampleRing<cpu_data> &from = samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -586,7 +591,7 @@ cpu_data StatsCPU::historyItemAtIndex(int index)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<cpu_data>::iterator cur = from.begin(); cur != from.end(); ++cur)
+		for (SampleRing<cpu_data>::const_iterator cur = from.begin(); cur != from.end(); ++cur)
 		{
 			if ((*cur).time > maximumTime)
 				continue;
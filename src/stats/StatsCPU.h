@@ -48,7 +48,7 @@ class StatsCPU : public StatsBase
 		void loadPreviousSamplesAtIndex(int index);
 		#endif
 
-	   	std::deque<cpu_data> samples[8];
+	   	SampleRing<cpu_data> samples[8];
 
 	   	#ifdef PST_MAX_CPUSTATES
 		unsigned long long last_ticks[PST_MAX_CPUSTATES];
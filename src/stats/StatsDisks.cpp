@@ -30,6 +30,8 @@
  */
 
 #include "StatsDisks.h"
+#include <errno.h>
+#include <sys/time.h>
 
 #ifndef _PATH_MOUNTED
 #ifdef MNTTAB
@@ -41,7 +43,211 @@
 
 using namespace std;
 
+StatsDisks::StatsDisks()
+{
+	probeTimeout = DISK_PROBE_TIMEOUT;
+	probeWaiting = 0;
+	pthread_mutex_init(&probeLock, NULL);
+
+	// Probe deadlines are on the monotonic clock, stepping the wall clock does not stretch them
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+#if defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) && defined(CLOCK_MONOTONIC)
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+#endif
+	pthread_cond_init(&probeDone, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+
+void StatsDisks::addSample(disk_info &disk, disk_data data)
+{
+	data.sampleID = sampleIndex[0].sampleID;
+	data.time = sampleIndex[0].time;
+
+	render_sample(data);
+	disk.samples[0].push_front(data);
+	if (disk.samples[0].size() > HISTORY_SIZE)
+		disk.samples[0].pop_back();
+}
+
 #ifdef USE_DISK_STATFS
+
+void* start_disk_probe(void*);
+void* start_disk_probe(void*a)
+{
+	DiskProbe *probe = static_cast<DiskProbe*>(a);
+	StatsDisks *owner = probe->owner;
+
+	disk_data data;
+	int result = owner->get_sizes(probe->mount.c_str(), &data);
+
+	pthread_mutex_lock(&owner->probeLock);
+	bool abandoned = probe->abandoned;
+	probe->data = data;
+	probe->result = result;
+	probe->running = false;
+	probe->finished = true;
+	probe->late = !probe->waited;
+	if (probe->waited)
+	{
+		probe->waited = false;
+		if (--owner->probeWaiting == 0)
+			pthread_cond_signal(&owner->probeDone);
+	}
+	pthread_mutex_unlock(&owner->probeLock);
+
+	if (abandoned)
+		delete probe;
+	return 0;
+}
+
+// Waits on probeDone until _deadline on the monotonic clock, called with probeLock held
+static void wait_for_probes(StatsDisks *_owner, double _deadline)
+{
+#if !defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) || !defined(CLOCK_MONOTONIC)
+	// The condition variable waits on the wall clock
+	_deadline = get_current_time() + (_deadline - get_monotonic_time());
+#endif
+
+	struct timespec until;
+	until.tv_sec = (time_t)_deadline;
+	until.tv_nsec = (long)((_deadline - until.tv_sec) * 1000000000.0);
+	pthread_cond_timedwait(&_owner->probeDone, &_owner->probeLock, &until);
+}
+
+void StatsDisks::startProbe(const string &key, const char *mount)
+{
+	DiskProbe *&probe = probes[key];
+	if (probe == NULL)
+	{
+		probe = new DiskProbe();
+		probe->owner = this;
+	}
+	probe->seen = sampleIndex[0].sampleID;
+
+	// A stale mount keeps at most one thread blocked on it
+	pthread_mutex_lock(&probeLock);
+	if (probe->running || get_monotonic_time() < probe->retryTime)
+	{
+		pthread_mutex_unlock(&probeLock);
+		return;
+	}
+	probe->mount = mount;
+	probe->running = true;
+	probe->finished = false;
+	probe->waited = true;
+	probe->started = get_monotonic_time();
+	probeWaiting++;
+	pthread_mutex_unlock(&probeLock);
+
+	pthread_t thread;
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	int created = pthread_create(&thread, &attributes, start_disk_probe, (void*)probe);
+	pthread_attr_destroy(&attributes);
+
+	// Out of threads, probe in place as before
+	if (created != 0)
+		start_disk_probe((void*)probe);
+}
+
+void StatsDisks::collectProbes()
+{
+	pthread_mutex_lock(&probeLock);
+
+	// Each probe gets the full timeout from its own start, a hung mount does not use up the others' wait
+	while (probeWaiting > 0)
+	{
+		DiskProbe *first = NULL;
+		for (map<string, DiskProbe *>::iterator probe = probes.begin(); probe != probes.end(); ++probe)
+		{
+			if (probe->second->waited && (first == NULL || probe->second->started < first->started))
+				first = probe->second;
+		}
+		if (first == NULL)
+			break;
+
+		double deadline = first->started + probeTimeout / 1000.0;
+		if (get_monotonic_time() < deadline)
+		{
+			wait_for_probes(this, deadline);
+			continue;
+		}
+
+		first->waited = false;
+		first->timedOut = true;
+		probeWaiting--;
+	}
+
+	double time = get_monotonic_time();
+	for (vector<disk_info>::iterator curdisk = _items.begin(); curdisk != _items.end(); ++curdisk)
+	{
+		map<string, DiskProbe *>::iterator found = probes.find((*curdisk).key);
+		if (found == probes.end() || found->second->seen != sampleIndex[0].sampleID)
+			continue;
+
+		DiskProbe *probe = found->second;
+		if (probe->finished)
+		{
+			probe->finished = false;
+
+			// A late result refreshes the size but the mount keeps its backoff
+			if (!probe->late)
+			{
+				if (probe->stale)
+					cout << "Disk " << probe->mount << " is responding again" << endl;
+				probe->stale = false;
+				probe->backoff = 0;
+				probe->retryTime = 0;
+			}
+
+			if (probe->result == 0)
+			{
+				probe->known = true;
+				probe->last = probe->data;
+				(*curdisk).active = true;
+				addSample(*curdisk, probe->last);
+				continue;
+			}
+		}
+
+		if (probe->timedOut)
+		{
+			probe->timedOut = false;
+
+			probe->backoff = probe->backoff == 0 ? DISK_PROBE_BACKOFF : min(probe->backoff * 2, (double)DISK_PROBE_BACKOFF_MAX);
+			probe->retryTime = time + probe->backoff;
+			if (!probe->stale)
+				cout << "Disk " << probe->mount << " did not respond within " << probeTimeout << " ms, serving its last size" << endl;
+			probe->stale = true;
+		}
+
+		if (probe->stale && probe->known)
+		{
+			(*curdisk).active = true;
+			addSample(*curdisk, probe->last);
+		}
+	}
+
+	// Mounts that are no longer listed, a probe still blocked in statvfs is freed by its thread
+	for (map<string, DiskProbe *>::iterator probe = probes.begin(); probe != probes.end(); )
+	{
+		if (probe->second->seen == sampleIndex[0].sampleID)
+		{
+			++probe;
+			continue;
+		}
+
+		if (probe->second->running)
+			probe->second->abandoned = true;
+		else
+			delete probe->second;
+		probes.erase(probe++);
+	}
+	pthread_mutex_unlock(&probeLock);
+}
+
 int StatsDisks::get_sizes(const char *dev, struct disk_data *data)
 {
 #ifdef HAVE_STATVFS
@@ -225,6 +431,8 @@ void StatsDisks::update(long long sampleID)
 			processDisk(entry[x].f_mntfromname, entry[x].f_mntonname, entry[x].f_fstypename);
 		}
 	#endif
+
+	collectProbes();
 }
 
 void StatsDisks::processDisk(char *name, char *mount, char *type)
@@ -328,18 +536,7 @@ void StatsDisks::processDisk(char *name, char *mount, char *type)
 				break;
 			}
 
-			disk_data data;
-			if (get_sizes(mount, &data) == 0)
-			{
-				(*curdisk).active = true;
-
-				data.sampleID = sampleIndex[0].sampleID;
-				data.time = sampleIndex[0].time;
-
-				(*curdisk).samples[0].push_front(data);
-				if ((*curdisk).samples[0].size() > HISTORY_SIZE)
-					(*curdisk).samples[0].pop_back();
-			}
+			startProbe((*curdisk).key, mount);
 		}
 	}
 }
@@ -418,6 +615,7 @@ void StatsDisks::loadHistoryForDisk(disk_info *disk)
 				sample.f = query.doubleForColumn("free");
 				sample.sampleID = (long long)query.doubleForColumn("sample");
 				sample.time = query.doubleForColumn("time");
+				render_sample(sample);
 				disk->samples[x].push_front(sample);
 			}
 		}
@@ -488,7 +686,7 @@ void StatsDisks::loadPreviousSamplesAtIndex(int index)
 		sample_data sample;
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -522,6 +720,7 @@ void StatsDisks::updateHistory()
 					{
 						disk_data sample = historyItemAtIndex(x, (*cur));
 
+						render_sample(sample);
 						(*cur).samples[x].push_front(sample);	
 						if ((*cur).samples[x].size() > HISTORY_SIZE) (*cur).samples[x].pop_back();
 
@@ -562,7 +761,7 @@ disk_data StatsDisks::historyItemAtIndex(int index, disk_info item)
 	double f = 0;
 	double t = 0;
 
-	std::deque<disk_data> from = item.samples[sampleIndex[index].historyIndex];
+	const SampleRing<disk_data> &from = item.samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -571,7 +770,7 @@ disk_data StatsDisks::historyItemAtIndex(int index, disk_info item)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<disk_data>::iterator cursample = from.begin(); cursample != from.end(); ++cursample)
+		for (SampleRing<disk_data>::const_iterator cursample = from.begin(); cursample != from.end(); ++cursample)
 		{
 			if ((*cursample).time > maximumTime)
 				continue;
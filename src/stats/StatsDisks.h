@@ -34,6 +34,16 @@
 #ifndef _STATSDISKS_H
 #define _STATSDISKS_H
 
+#include <map>
+#include <pthread.h>
+
+// Milliseconds a tick waits for statvfs before serving a mount's last size
+#define DISK_PROBE_TIMEOUT 500
+
+// Seconds before a stale mount is probed again, doubled on every timeout
+#define DISK_PROBE_BACKOFF 10
+#define DISK_PROBE_BACKOFF_MAX 600
+
 class disk_info
 {
 	public:
@@ -46,11 +56,52 @@ class disk_info
 		std::string key;
 		std::string displayName;
 		double last_update;
-		std::deque<disk_data> samples[8];
+		SampleRing<disk_data> samples[8];
+};
+
+class StatsDisks;
+
+// statvfs of one mount, run on its own thread so that a hung NFS, CIFS or
+// FUSE mount stalls only its probe and never the tick
+class DiskProbe
+{
+	public:
+		DiskProbe() : owner(NULL), running(false), waited(false), timedOut(false), abandoned(false), started(0), finished(false), late(false), result(-1), known(false), stale(false), retryTime(0), backoff(0), seen(-1) {}
+
+		StatsDisks *owner;
+		std::string mount;
+
+		// Guarded by the owner's probeLock. mount is left alone while running.
+		bool running;
+		bool waited;
+		bool timedOut;
+
+		// The mount is gone, the probe thread frees the probe when statvfs returns
+		bool abandoned;
+
+		// Monotonic time the probe thread was started, its deadline counts from here
+		double started;
+		bool finished;
+		// Finished after its deadline had passed, the mount still counts as stale
+		bool late;
+		int result;
+		disk_data data;
+
+		// Last size read, served while the mount does not respond
+		bool known;
+		disk_data last;
+		bool stale;
+		double retryTime;
+		double backoff;
+
+		// Tick in which the mount was last listed
+		long long seen;
 };
+
 class StatsDisks : public StatsBase
 {
 	public:
+		StatsDisks();
 		int useMountPaths;
 		int disableFiltering;
 		void update(long long sampleID);
@@ -65,6 +116,16 @@ class StatsDisks : public StatsBase
 		int should_ignore_mount(char *mount);
 		std::vector<std::string> customNames;
 
+		// Milliseconds to wait for statvfs of each mount, disk_probe_timeout
+		int probeTimeout;
+		void startProbe(const std::string &key, const char *mount);
+		void collectProbes();
+		void addSample(disk_info &disk, disk_data data);
+		pthread_mutex_t probeLock;
+		pthread_cond_t probeDone;
+		int probeWaiting;
+		std::map<std::string, DiskProbe *> probes;
+
 		void loadHistoryForDisk(disk_info *disk);
 		#ifdef USE_SQLITE
 		void updateHistory();
@@ -131,6 +131,7 @@ void StatsLoad::addSample(load_data data, long long sampleID)
 	data.sampleID = sampleIndex[0].sampleID;
 	data.time = sampleIndex[0].time;
 
+	render_sample(data);
 	samples[0].push_front(data);	
 	if (samples[0].size() > HISTORY_SIZE) samples[0].pop_back();
 }
@@ -164,7 +165,8 @@ void StatsLoad::loadPreviousSamplesAtIndex(int index)
 		sample.three = query.doubleForColumn("fifteen");
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		render_sample(sample);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -194,6 +196,7 @@ void StatsLoad::updateHistory()
 
 				load_data sample = historyItemAtIndex(x);
 
+				render_sample(sample);
 				samples[x].push_front(sample);	
 				if (samples[x].size() > HISTORY_SIZE) samples[x].pop_back();
 
@@ -218,7 +221,7 @@ void StatsLoad::updateHistory()
 
 load_data StatsLoad::historyItemAtIndex(int index)
 {
-	std::deque<load_data> from = samples[sampleIndex[index].historyIndex];
+	const SampleRing<load_data> &from = samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -232,7 +235,7 @@ load_data StatsLoad::historyItemAtIndex(int index)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<load_data>::iterator cur = from.begin(); cur != from.end(); ++cur)
+		for (SampleRing<load_data>::const_iterator cur = from.begin(); cur != from.end(); ++cur)
 		{
 			if ((*cur).time > maximumTime)
 				continue;
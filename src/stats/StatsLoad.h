@@ -39,7 +39,7 @@ class StatsLoad : public StatsBase
 	public:
 		void update(long long sampleID);
 		void addSample(load_data data, long long sampleID);
-	   	std::deque<load_data> samples[8];
+	   	SampleRing<load_data> samples[8];
 
 		void init();
 		#ifdef USE_SQLITE
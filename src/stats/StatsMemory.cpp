@@ -774,6 +774,7 @@ void StatsMemory::addSample(mem_data data, long long sampleID)
 	data.sampleID = sampleIndex[0].sampleID;
 	data.time = sampleIndex[0].time;
 
+	render_sample(data);
 	samples[0].push_front(data);	
 	if (samples[0].size() > HISTORY_SIZE) samples[0].pop_back();
 }
@@ -852,6 +853,7 @@ void StatsMemory::loadPreviousSamplesAtIndex(int index)
 
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
+		render_sample(sample);
 		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
@@ -882,6 +884,7 @@ void StatsMemory::updateHistory()
 
 				mem_data sample = historyItemAtIndex(x);
 
+				render_sample(sample);
 				samples[x].push_front(sample);	
 				if (samples[x].size() > HISTORY_SIZE) samples[x].pop_back();
 
@@ -926,7 +929,7 @@ void StatsMemory::updateHistory()
 
 mem_data StatsMemory::historyItemAtIndex(int index)
 {
-	std::deque<mem_data> from = samples[sampleIndex[index].historyIndex];
+	const SampleRing<mem_data> &from = samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -943,7 +946,7 @@ mem_data StatsMemory::historyItemAtIndex(int index)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<mem_data>::iterator cur = from.begin(); cur != from.end(); ++cur)
+		for (SampleRing<mem_data>::const_iterator cur = from.begin(); cur != from.end(); ++cur)
 		{
 			if ((*cur).time > maximumTime)
 				continue;
@@ -40,7 +40,7 @@ class StatsMemory : public StatsBase
 		void update(long long sampleID);
 		void addSample(mem_data data, long long sampleID);
 		void prepareSample(mem_data* data);
-	   	std::deque<mem_data> samples[8];
+	   	SampleRing<mem_data> samples[8];
 
 	   	std::deque<std::string> databaseKeys;
 	   	std::deque<int> databaseMap;
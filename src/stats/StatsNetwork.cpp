@@ -570,6 +570,7 @@ void StatsNetwork::createInterface(string key)
 				sample.u = query.doubleForColumn("upload");
 				sample.sampleID = (long long)query.doubleForColumn("sample");
 				sample.time = query.doubleForColumn("time");
+				render_sample(sample);
 				item.samples[x].push_front(sample);
 			}
 		}
@@ -614,6 +615,7 @@ void StatsNetwork::processInterface(string key, long long sampleID, unsigned lon
 			data.sampleID = sampleIndex[0].sampleID;
 			data.time = sampleIndex[0].time;
 
+			render_sample(data);
 			(*cur).samples[0].push_front(data);
 			if ((*cur).samples[0].size() > HISTORY_SIZE)
 				(*cur).samples[0].pop_back();
@@ -702,7 +704,7 @@ void StatsNetwork::loadPreviousSamplesAtIndex(int index)
 		sample_data sample;
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -736,6 +738,7 @@ void StatsNetwork::updateHistory()
 					{
 						net_data sample = historyItemAtIndex(x, (*cur));
 
+						render_sample(sample);
 						(*cur).samples[x].push_front(sample);	
 						if ((*cur).samples[x].size() > HISTORY_SIZE) (*cur).samples[x].pop_back();
 
@@ -774,7 +777,7 @@ net_data StatsNetwork::historyItemAtIndex(int index, network_info item)
 	double u = 0;
 	double d = 0;
 
-	std::deque<net_data> from = item.samples[sampleIndex[index].historyIndex];
+	const SampleRing<net_data> &from = item.samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -783,7 +786,7 @@ net_data StatsNetwork::historyItemAtIndex(int index, network_info item)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<net_data>::iterator cursample = from.begin(); cursample != from.end(); ++cursample)
+		for (SampleRing<net_data>::const_iterator cursample = from.begin(); cursample != from.end(); ++cursample)
 		{
 			if ((*cursample).time > maximumTime)
 				continue;
@@ -46,7 +46,7 @@ class network_info
 		std::string device;
 		double last_update;
 		
-		std::deque<net_data> samples[8];
+		SampleRing<net_data> samples[8];
 };
 
 class StatsNetwork : public StatsBase
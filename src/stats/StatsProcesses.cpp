@@ -544,6 +544,7 @@ void StatsProcesses::processProcess(int pid, long long sampleID)
 
 void StatsProcesses::prepareUpdate()
 {
+	generation++;
 	threadCount = 0;
 	processCount = 0;
 
@@ -556,6 +557,32 @@ void StatsProcesses::prepareUpdate()
 	}
 }
 
+// Orders positions in _items by one field, largest first
+template <class T>
+class ProcessOrder
+{
+	public:
+		ProcessOrder(const vector<process_info> &_items, T process_info::*_field) : items(_items), field(_field) {}
+		bool operator () (size_t i, size_t j) const { return items[j].*field < items[i].*field; }
+
+	private:
+		const vector<process_info> &items;
+		T process_info::*field;
+};
+
+template <class T>
+void StatsProcesses::rank(vector<size_t> &_ranking, T process_info::*_field)
+{
+	size_t ranked = std::min(_items.size(), rankingSize);
+
+	_ranking.resize(_items.size());
+	for (size_t i = 0; i < _ranking.size(); i++)
+		_ranking[i] = i;
+
+	std::partial_sort(_ranking.begin(), _ranking.begin() + ranked, _ranking.end(), ProcessOrder<T>(_items, _field));
+	_ranking.resize(ranked);
+}
+
 void StatsProcesses::finishUpdate()
 {
 	if(_items.size() > 0)
@@ -568,4 +595,9 @@ void StatsProcesses::finishUpdate()
 			}
 		}
 	}
+
+	rank(cpuRanking, &process_info::cpu);
+	rank(memoryRanking, &process_info::memory);
+	rank(ioReadRanking, &process_info::io_read);
+	rank(ioWriteRanking, &process_info::io_write);
 }
@@ -56,9 +56,14 @@ class process_info
 		long long sampleID;
 		char name[128];
 };
+
+// Rows shown for each ranking when process_top_count is not set
+#define PROCESS_RANKING_SIZE 20
+
 class StatsProcesses : public StatsBase
 {
 	public:
+		StatsProcesses() : rankingSize(PROCESS_RANKING_SIZE) {}
 		void update(long long sampleID, double ticks);
 		void prepareUpdate();
 		void init();
@@ -77,5 +82,16 @@ class StatsProcesses : public StatsBase
 		#endif
 
 		void finishUpdate();
+
+		// Positions in _items of the busiest processes, highest first. Ranked once
+		// per sample in finishUpdate(), responses only write out these rows.
+		size_t rankingSize;
+		std::vector<size_t> cpuRanking;
+		std::vector<size_t> memoryRanking;
+		std::vector<size_t> ioReadRanking;
+		std::vector<size_t> ioWriteRanking;
+
+	private:
+		template <class T> void rank(std::vector<size_t> &_ranking, T process_info::*_field);
 	};
 #endif
@@ -885,6 +885,7 @@ int StatsSensors::createSensor(string key)
 				sample.value = query.doubleForColumn("value");
 				sample.sampleID = (long long)query.doubleForColumn("sample");
 				sample.time = query.doubleForColumn("time");
+				render_sample(sample);
 				item.samples[x].push_front(sample);
 			}
 		}
@@ -908,6 +909,7 @@ void StatsSensors::processSensor(string key, long long sampleID, double value)
 			data.sampleID = sampleIndex[0].sampleID;
 			data.time = sampleIndex[0].time;
 
+			render_sample(data);
 			(*cur).samples[0].push_front(data);
 			if ((*cur).samples[0].size() > HISTORY_SIZE)
 				(*cur).samples[0].pop_back();
@@ -1001,7 +1003,7 @@ void StatsSensors::loadPreviousSamplesAtIndex(int index)
 		sample_data sample;
 		sample.sampleID = (long long)query.doubleForColumn("sample");
 		sample.time = query.doubleForColumn("time");
-		samples[index].insert(samples[index].begin(), sample);
+		samples[index].push_front(sample);
 	}
 	if(samples[index].size() > 0)
 	{
@@ -1035,6 +1037,7 @@ void StatsSensors::updateHistory()
 					{
 						sensor_data sample = historyItemAtIndex(x, (*cur));
 
+						render_sample(sample);
 						(*cur).samples[x].push_front(sample);	
 						if ((*cur).samples[x].size() > HISTORY_SIZE) (*cur).samples[x].pop_back();
 
@@ -1072,7 +1075,7 @@ sensor_data StatsSensors::historyItemAtIndex(int index, sensor_info item)
 	sensor_data sample;
 	double value = 0;
 
-	std::deque<sensor_data> from = item.samples[sampleIndex[index].historyIndex];
+	const SampleRing<sensor_data> &from = item.samples[sampleIndex[index].historyIndex];
 	double minimumTime = sampleIndex[index].time - sampleIndex[index].interval;
 	double maximumTime = sampleIndex[index].time;
 	if(sampleIndex[index].historyIndex == 0)
@@ -1081,7 +1084,7 @@ sensor_data StatsSensors::historyItemAtIndex(int index, sensor_info item)
 	int count = 0;
 	if(from.size() > 0)
 	{
-		for (deque<sensor_data>::iterator cursample = from.begin(); cursample != from.end(); ++cursample)
+		for (SampleRing<sensor_data>::const_iterator cursample = from.begin(); cursample != from.end(); ++cursample)
 		{
 			if ((*cursample).time > maximumTime){
 				continue;
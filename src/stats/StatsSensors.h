@@ -53,7 +53,7 @@ class sensor_info
 		unsigned int sensor;
 		int method;
 
-		std::deque<sensor_data> samples[8];
+		SampleRing<sensor_data> samples[8];
 };
 
 class StatsSensors : public StatsBase